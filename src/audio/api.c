@@ -30,7 +30,7 @@ BEGIN_MODULE(audio)
 	BEGIN_CLASS(sound)
 		ADD_METHOD(sound, play)
 		ADD_GC(free_sound)
-	REGISTER_CLASS(sound, "Sound")
+	REGISTER_LEAN_CLASS(sound, "Sound")
 
 	BEGIN_CLASS(music)
 		ADD_METHOD(music, play)
@@ -39,6 +39,6 @@ BEGIN_MODULE(audio)
 		ADD_METHOD(music, set_pitch)
 		ADD_METHOD(music, set_volume)
 		ADD_GC(free_music)
-	REGISTER_CLASS(music, "Music")
+	REGISTER_LEAN_CLASS(music, "Music")
 END_MODULE()
 
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <AL/al.h>
 
 typedef struct Music Music;
@@ -42,6 +43,7 @@ struct Music {
 	int samplesrate;
 	unsigned int buffersize;
 	int ref;
+	size_t registry_index; // see object_registry.h
 	int onend_clb;
 	float pitch;
 	float volume;
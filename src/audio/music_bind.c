@@ -22,10 +22,13 @@
 #include "music.h"
 #include "lua_util.h"
 #include "util.h"
+#ifdef BUILD_UTILS
+#include "utils/array_bind.h"
+#endif
 
 log_category("music");
 
-IMPLEMENT_PUSHPOP(Music, music)
+IMPLEMENT_LEAN_PUSHPOP(Music, music, OBJECT_MUSIC)
 
 typedef struct LuaMusicCallback LuaMusicCallback;
 struct LuaMusicCallback {
@@ -34,6 +37,10 @@ struct LuaMusicCallback {
 	lua_State* L;
 	int ref;
 	int table_ref;
+#ifdef BUILD_UTILS
+	// when set, table_ref references this float32 array instead of a table
+	Array *array;
+#endif
 };
 
 static unsigned int lmc_feed_buffer(MusicCallback *mc, unsigned short *buffer, unsigned int len)
@@ -52,6 +59,10 @@ static unsigned int lmc_feed_buffer(MusicCallback *mc, unsigned short *buffer, u
 		lua_createtable(L, len, 0);
 		lmc->table_ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	}
+#ifdef BUILD_UTILS
+	if (lmc->array && lmc->array->length < len)
+		len = lmc->array->length;
+#endif
 	lua_rawgeti(L, LUA_REGISTRYINDEX, lmc->ref);
 	lua_rawgeti(L, LUA_REGISTRYINDEX, lmc->table_ref);
 	lua_pushinteger(L, len);
@@ -59,14 +70,26 @@ static unsigned int lmc_feed_buffer(MusicCallback *mc, unsigned short *buffer, u
 
 	i = luaL_checkinteger(L, -1);
 	lua_pop(L, 1);
+	if (i > len)
+		i = len;
+
+#ifdef BUILD_UTILS
+	if (lmc->array) {
+		const float *samples = lmc->array->data;
+		for (k = 0; k < i; k++)
+			buffer[k] = samples[k] * (1 << 15) + (1 << 15);
+		return i;
+	}
+#endif
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, lmc->table_ref);
 	for (k = 1; k <= i; k++) {
 		lua_rawgeti(L, -1, k);
 		lua_Number sample = luaL_checknumber(L, -1);
-		buffer[k] = sample * (1 << 15) + (1 << 15);
+		buffer[k - 1] = sample * (1 << 15) + (1 << 15);
 		lua_pop(L, 1);
 	}
+	lua_pop(L, 1);
 
 	return i;
 }
@@ -92,6 +115,11 @@ static void lmc_free(MusicCallback *mc)
 static LuaMusicCallback *lmc_new(lua_State *L)
 {
 	LuaMusicCallback *lmc;
+#ifdef BUILD_UTILS
+	Array *array = test_array(L, 3);
+
+	assert_lua_error(L, !array || array->type == ARRAY_FLOAT32, "load_music: the array must be float32");
+#endif
 
 	lmc = new(LuaMusicCallback, 1);
 
@@ -99,6 +127,13 @@ static LuaMusicCallback *lmc_new(lua_State *L)
 	lua_pushvalue(L, 1);
 	lmc->ref = luaL_ref(L, LUA_REGISTRYINDEX);
 	lmc->table_ref = LUA_NOREF;
+#ifdef BUILD_UTILS
+	lmc->array = array;
+	if (array) {
+		lua_pushvalue(L, 3);
+		lmc->table_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+#endif
 	lmc->base.free = lmc_free;
 	lmc->base.rewind = lmc_rewind;
 	lmc->base.feed_buffer = lmc_feed_buffer;
@@ -195,6 +230,7 @@ int mlua_free_music(lua_State *L)
 	assert(L);
 
 	Music* music = pop_music(L, 1);
+	object_registry_remove(OBJECT_MUSIC, &music->registry_index);
 	music_free(music);
 	return 0;
 }
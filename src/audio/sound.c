@@ -28,7 +28,7 @@
 
 log_category("sound");
 
-static Sound *sound_new(ALushort* buffer, unsigned int length, int samplesrate, unsigned bits_per_sample, unsigned num_channels)
+static Sound *sound_new(const ALushort* buffer, unsigned int length, int samplesrate, unsigned bits_per_sample, unsigned num_channels)
 {
 	Sound *s;
 	ALenum format = AL_FORMAT_MONO8;
@@ -112,6 +112,17 @@ Sound* sound_load(unsigned int len, const float* buffer, int samplesrate)
 	return sound;
 }
 
+Sound* sound_load_int16(unsigned int len, const int16_t* buffer, int samplesrate)
+{
+	assert(buffer);
+
+	if (!audio_init_if_needed())
+		return NULL;
+
+	// already in the format of AL_FORMAT_MONO16, OpenAL copies it as is
+	return sound_new((const ALushort *) buffer, len * sizeof(int16_t), samplesrate, 16, 1);
+}
+
 void sound_free(Sound *s)
 {
 	if (!s)
@@ -17,6 +17,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <AL/al.h>
 
 typedef struct Sound Sound;
@@ -26,6 +28,7 @@ struct Sound {
 	char* filename;
 	bool free_me;
 	int ref;
+	size_t registry_index; // see object_registry.h
 };
 
 void sound_play(Sound *sound, float volume, float x, float y, float pitch);
@@ -33,4 +36,5 @@ void sound_free(Sound *sound);
 
 int sound_load_from_file(const char *filepath, Sound **sound);
 Sound *sound_load(unsigned int len, const float* buffer, int samplesrate);
+Sound *sound_load_int16(unsigned int len, const int16_t* buffer, int samplesrate);
 
@@ -23,10 +23,14 @@
 #include "sound.h"
 #include "audio.h"
 #include "lua_util.h"
+#include "util.h"
+#ifdef BUILD_UTILS
+#include "utils/array_bind.h"
+#endif
 
 log_category("sound");
 
-IMPLEMENT_PUSHPOP(Sound, sound)
+IMPLEMENT_LEAN_PUSHPOP(Sound, sound, OBJECT_SOUND)
 
 int mlua_load_sound(lua_State *L)
 {
@@ -47,7 +51,31 @@ int mlua_load_sound(lua_State *L)
 		}
 		push_sound(L, sound);
 		return 1;
-	} else {
+	}
+#ifdef BUILD_UTILS
+	Array *array = test_array(L, 1);
+	if (array) {
+		/*
+		 * [1]: array
+		 * [2]: number (optional)
+		 * 	len = number or array.length
+		 * 	the data is read from the array buffer, int16 samples are given to OpenAL as is
+		 */
+		unsigned int len = luaL_optinteger(L, 2, array->length);
+		assert_lua_error(L, len <= array->length, "load_sound: the array is too short");
+		assert_lua_error(L, array->type != ARRAY_UINT8, "load_sound: the array must be float32 or int16");
+
+		Sound *chunk;
+		if (array->type == ARRAY_FLOAT32) {
+			chunk = sound_load(len, array->data, DEFAULT_SAMPLES_RATE);
+		} else {
+			chunk = sound_load_int16(len, array->data, DEFAULT_SAMPLES_RATE);
+		}
+		push_sound(L, chunk);
+		return 1;
+	}
+#endif
+	{
 		/*
 		 * Multiple configurations allowed:
 		 * [1]: table
@@ -125,6 +153,7 @@ int mlua_free_sound(lua_State *L)
 	assert(L);
 
 	Sound* sound = pop_sound(L, 1);
+	object_registry_remove(OBJECT_SOUND, &sound->registry_index);
 	sound_free(sound);
 	return 0;
 }
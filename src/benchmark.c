@@ -0,0 +1,142 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+#include "util.h"
+
+const char *BENCHMARK_PHASE_NAMES[BENCHMARK_PHASE_COUNT] = {
+	"frame",
+	"events",
+	"audio",
+	"update",
+	"draw",
+	"flip",
+};
+
+Benchmark *benchmark_new(void)
+{
+	return new0(Benchmark, 1);
+}
+
+void benchmark_free(Benchmark *b)
+{
+	if (!b)
+		return;
+
+	for (int i = 0; i < BENCHMARK_PHASE_COUNT; i++)
+		free(b->durations[i]);
+	free(b);
+}
+
+void benchmark_add_frame(Benchmark *b, const unsigned long durations[BENCHMARK_PHASE_COUNT])
+{
+	assert(b);
+	assert(durations);
+
+	if (b->frames_count == b->frames_size) {
+		size_t size = b->frames_size;
+		// all the arrays grow the same way
+		for (int i = 0; i < BENCHMARK_PHASE_COUNT; i++) {
+			size = b->frames_size;
+			XREALLOC(b->durations[i], size, b->frames_count + 1);
+		}
+		b->frames_size = size;
+	}
+	for (int i = 0; i < BENCHMARK_PHASE_COUNT; i++)
+		b->durations[i][b->frames_count] = durations[i];
+	b->frames_count++;
+}
+
+static int compare_durations(const void *a, const void *b)
+{
+	unsigned long da = *(const unsigned long *) a;
+	unsigned long db = *(const unsigned long *) b;
+
+	return da < db ? -1 : da > db;
+}
+
+// nearest-rank percentile of sorted values
+static unsigned long percentile(const unsigned long *sorted, size_t count, unsigned int p)
+{
+	size_t rank = (count * p + 99) / 100;
+
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void write_phase(FILE *f, const unsigned long *durations, size_t count, unsigned long *sorted)
+{
+	unsigned long long total = 0;
+
+	for (size_t i = 0; i < count; i++)
+		total += durations[i];
+	memcpy(sorted, durations, count * sizeof(*sorted));
+	qsort(sorted, count, sizeof(*sorted), compare_durations);
+
+	fprintf(f, "{\"mean\": %.1f, \"min\": %lu, \"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}",
+	        (double) total / count, sorted[0], percentile(sorted, count, 50),
+	        percentile(sorted, count, 90), percentile(sorted, count, 99), sorted[count - 1]);
+}
+
+int benchmark_write_json(const Benchmark *b, const char *filename, float fixed_dt)
+{
+	FILE *f;
+	unsigned long *sorted;
+
+	assert(b);
+	assert(filename);
+
+	f = fopen(filename, "w");
+	if (!f)
+		return -errno;
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"frames\": %zu,\n", b->frames_count);
+	if (fixed_dt > 0)
+		fprintf(f, "\t\"fixed_dt\": %g,\n", (double) fixed_dt);
+	else
+		fprintf(f, "\t\"fixed_dt\": null,\n");
+	fprintf(f, "\t\"unit\": \"us\",\n");
+
+	fprintf(f, "\t\"phases\": {");
+	if (b->frames_count > 0) {
+		sorted = new(unsigned long, b->frames_count);
+		for (int i = 0; i < BENCHMARK_PHASE_COUNT; i++) {
+			fprintf(f, "%s\n\t\t\"%s\": ", i ? "," : "", BENCHMARK_PHASE_NAMES[i]);
+			write_phase(f, b->durations[i], b->frames_count, sorted);
+		}
+		free(sorted);
+		fprintf(f, "\n\t");
+	}
+	fprintf(f, "},\n");
+
+	fprintf(f, "\t\"frame_durations\": [");
+	for (size_t i = 0; i < b->frames_count; i++)
+		fprintf(f, "%s%lu", i ? ", " : "", b->durations[BENCHMARK_FRAME][i]);
+	fprintf(f, "]\n}\n");
+
+	if (ferror(f)) {
+		fclose(f);
+		return -EIO;
+	}
+	if (fclose(f) != 0)
+		return -errno;
+	return 0;
+}
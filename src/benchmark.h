@@ -0,0 +1,51 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stddef.h>
+
+enum BenchmarkPhase {
+	BENCHMARK_FRAME,
+	BENCHMARK_EVENTS,
+	BENCHMARK_AUDIO,
+	BENCHMARK_UPDATE,
+	BENCHMARK_DRAW,
+	BENCHMARK_FLIP,
+	BENCHMARK_PHASE_COUNT,
+};
+typedef enum BenchmarkPhase BenchmarkPhase;
+
+typedef struct Benchmark Benchmark;
+
+struct Benchmark {
+	// durations in microseconds, one array of frames_count values per phase
+	unsigned long *durations[BENCHMARK_PHASE_COUNT];
+	size_t frames_count;
+	size_t frames_size;
+};
+
+extern const char *BENCHMARK_PHASE_NAMES[BENCHMARK_PHASE_COUNT];
+
+Benchmark *benchmark_new(void);
+void benchmark_free(Benchmark *b);
+void benchmark_add_frame(Benchmark *b, const unsigned long durations[BENCHMARK_PHASE_COUNT]);
+
+/*
+ * Writes the percentiles of each phase and the duration of every frame.
+ * fixed_dt is written as null if it is 0.
+ */
+int benchmark_write_json(const Benchmark *b, const char *filename, float fixed_dt);
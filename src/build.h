@@ -34,6 +34,12 @@
 #define _GRAPHICS_FEATURE_ "-GRAPHICS"
 #endif
 
+#ifdef BUILD_HEADLESS
+#define _HEADLESS_FEATURE_ "+HEADLESS"
+#else
+#define _HEADLESS_FEATURE_ "-HEADLESS"
+#endif
+
 #ifdef BUILD_LIVECODING
 #define _LIVECODING_FEATURE_ "+LIVECODING"
 #else
@@ -74,6 +80,7 @@
 	_AUDIO_FEATURE_ " " \
 	_FONT_FEATURE_ " " \
 	_GRAPHICS_FEATURE_ " " \
+	_HEADLESS_FEATURE_ " " \
 	_LIVECODING_FEATURE_ " " \
 	_PHYSICS_FEATURE_ " " \
 	_PARTICLE_FEATURE_ " " \
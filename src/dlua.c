@@ -17,6 +17,8 @@
 #include <math.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -29,6 +31,9 @@
 #include "dlua.h"
 #include "luafiles.h"
 #include "module.h"
+#include "profiler.h"
+#include "lua_profiler.h"
+#include "lua_allocator.h"
 #ifdef BUILD_PHYSICS
 #include "physics/api.hpp"
 #endif
@@ -70,18 +75,96 @@ static int luaopen_drystal(lua_State*); // defined at the end of this file
 
 static struct DrystalLua {
 	lua_State* L;
+	LuaAllocator *allocator;
 	int drystal_table_ref;
 	bool library_loaded;
 	const char* filename;
+	bool gc_sentinel_alive;
+	// the current run of frees, see traced_alloc
+	unsigned long sweep_frees;
+	unsigned long sweep_start;
+	unsigned long sweep_end;
+	// registry references, LUA_REFNIL or LUA_NOREF when the callback is not set
+	int callback_refs[CALLBACK_COUNT];
 } dlua;
 
+const char *DLUA_CALLBACK_NAMES[CALLBACK_COUNT] = {
+	[CALLBACK_INIT] = "init",
+	[CALLBACK_UPDATE] = "update",
+	[CALLBACK_DRAW] = "draw",
+	[CALLBACK_ATEXIT] = "atexit",
+	[CALLBACK_EVENTS] = "events",
+	[CALLBACK_MOUSE_MOTION] = "mouse_motion",
+	[CALLBACK_MOUSE_PRESS] = "mouse_press",
+	[CALLBACK_MOUSE_RELEASE] = "mouse_release",
+	[CALLBACK_KEY_PRESS] = "key_press",
+	[CALLBACK_KEY_RELEASE] = "key_release",
+	[CALLBACK_KEY_TEXT] = "key_text",
+	[CALLBACK_PAGE_RESIZE] = "page_resize",
+	[CALLBACK_ON_WGET_SUCCESS] = "on_wget_success",
+	[CALLBACK_ON_WGET_ERROR] = "on_wget_error",
+};
+
+// same as luaL_newstate's
+static int panic(lua_State *L)
+{
+	fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+	return 0;
+}
+
+// shorter runs of frees are not recorded, they are not worth a record
+#define GC_SWEEP_MIN_FREES 16
+// microseconds between two frees of the same run
+#define GC_SWEEP_MAX_GAP 50
+
+static void flush_gc_sweep(void)
+{
+	if (dlua.sweep_frees >= GC_SWEEP_MIN_FREES && profiler_running)
+		profiler_record("gc_sweep", dlua.sweep_start, dlua.sweep_end);
+	dlua.sweep_frees = 0;
+}
+
+/*
+ * Installed while the profiler runs. Lua frees its objects only when it
+ * sweeps them, so a run of frees without any allocation in between is a
+ * step of the collector, run by the engine or triggered by an allocation.
+ * The marking does not free anything and is not seen here.
+ */
+static void *traced_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	if (ptr && nsize == 0) {
+		unsigned long now = profiler_now();
+		if (dlua.sweep_frees && now - dlua.sweep_end > GC_SWEEP_MAX_GAP)
+			flush_gc_sweep();
+		if (!dlua.sweep_frees)
+			dlua.sweep_start = now;
+		dlua.sweep_end = now;
+		dlua.sweep_frees++;
+	} else if (dlua.sweep_frees) {
+		flush_gc_sweep();
+	}
+	return lua_allocator_alloc(ud, ptr, osize, nsize);
+}
+
+static void dlua_trace_allocations(bool trace)
+{
+	flush_gc_sweep();
+	lua_setallocf(dlua.L, trace ? traced_alloc : lua_allocator_alloc, dlua.allocator);
+}
+
 void dlua_init(const char *filename)
 {
-	lua_State *L = luaL_newstate();
+	dlua.allocator = lua_allocator_new();
+	lua_State *L = lua_newstate(lua_allocator_alloc, dlua.allocator);
+	lua_atpanic(L, panic);
 	dlua.L = L;
 	dlua.drystal_table_ref = LUA_NOREF;
 	dlua.filename = filename;
 	dlua.library_loaded = false;
+	dlua.gc_sentinel_alive = false;
+	dlua.sweep_frees = 0;
+	for (int i = 0; i < CALLBACK_COUNT; i++)
+		dlua.callback_refs[i] = LUA_NOREF;
 	luaL_openlibs(L);
 
 	// add arg table, with filename at index 0
@@ -93,8 +176,41 @@ void dlua_init(const char *filename)
 
 void dlua_free(void)
 {
+	// no more gc sentinel nor sweep records while closing
+	profiler_stop();
+	dlua_trace_allocations(false);
+	lua_profiler_free();
 	luaL_unref(dlua.L, LUA_REGISTRYINDEX, dlua.drystal_table_ref);
 	lua_close(dlua.L);
+	lua_allocator_free(dlua.allocator);
+	object_registry_free();
+}
+
+bool dlua_gc_step(size_t kbytes)
+{
+	PROFILER_BEGIN(step);
+	bool finished = lua_gc(dlua.L, LUA_GCSTEP, kbytes < INT_MAX ? (int) kbytes : INT_MAX);
+	PROFILER_END(step, "gc_step");
+	return finished;
+}
+
+void dlua_set_gc_automatic(bool automatic)
+{
+	lua_gc(dlua.L, automatic ? LUA_GCRESTART : LUA_GCSTOP, 0);
+}
+
+size_t dlua_get_allocated_bytes(void)
+{
+	LuaAllocatorStats stats;
+
+	lua_allocator_get_stats(dlua.allocator, &stats);
+	return stats.allocated_bytes;
+}
+
+void dlua_end_frame(void)
+{
+	lua_allocator_end_frame(dlua.allocator);
+	flush_gc_sweep();
 }
 
 lua_State *dlua_get_lua_state(void)
@@ -123,9 +239,9 @@ void dlua_get_drystal_field(const char* name)
 
 	assert(name);
 
+	// not raw, the callbacks are only reachable through __index
 	lua_rawgeti(L, LUA_REGISTRYINDEX, dlua.drystal_table_ref);
-	lua_pushstring(L, name);
-	lua_rawget(L, -2);
+	lua_getfield(L, -1, name);
 	lua_remove(L, lua_gettop(L) - 1);
 }
 
@@ -148,6 +264,51 @@ bool dlua_get_function(const char* name)
 	return false;
 }
 
+bool dlua_get_callback(DluaCallback callback)
+{
+	lua_State *L = dlua.L;
+
+	assert(callback < CALLBACK_COUNT);
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, dlua.callback_refs[callback]);
+	if (lua_isfunction(L, -1)) {
+		return true;
+	}
+	lua_pop(L, 1);
+	return false;
+}
+
+static void set_callback(lua_State *L, DluaCallback callback, int index)
+{
+	luaL_unref(L, LUA_REGISTRYINDEX, dlua.callback_refs[callback]);
+	lua_pushvalue(L, index);
+	// LUA_REFNIL for nil
+	dlua.callback_refs[callback] = luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+/*
+ * Callbacks stored with rawset do not go through __newindex,
+ * moves them to callback_refs after (re)loading the code.
+ */
+static void move_raw_callbacks(void)
+{
+	lua_State *L = dlua.L;
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, dlua.drystal_table_ref);
+	for (int i = 0; i < CALLBACK_COUNT; i++) {
+		lua_pushstring(L, DLUA_CALLBACK_NAMES[i]);
+		lua_rawget(L, -2);
+		if (!lua_isnil(L, -1)) {
+			set_callback(L, i, -1);
+			lua_pushstring(L, DLUA_CALLBACK_NAMES[i]);
+			lua_pushnil(L);
+			lua_rawset(L, -4);
+		}
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+}
+
 static void register_modules(void)
 {
 #ifdef BUILD_AUDIO
@@ -211,66 +372,51 @@ bool dlua_load_code(void)
 	}
 
 	call_lua_function(L, 0, 0);
+	move_raw_callbacks();
 
 	assert(lua_gettop(L) == 0);
 	return true;
 }
 
-bool dlua_foreach(const char* type, bool(*callback)(void* data, const void* callback_arg), const void* callback_arg)
+bool dlua_foreach(ObjectType type, bool(*callback)(void* data, const void* callback_arg), const void* callback_arg)
 {
-	assert(type);
 	assert(callback);
 
 	bool result = false;
-	lua_State *L = dlua.L;
-	lua_getfield(L, LUA_REGISTRYINDEX, "objects");
-	lua_pushnil(L);
-	while (lua_next(L, -2)) {
-		if (lua_istable(L, -1)) {
-			lua_getfield(L, -1, "__self");
-			lua_replace(L, -2);
-		}
-
-		lua_getfield(L, -1, "__type");
-		const char* t = lua_tostring(L, -1);
-		lua_pop(L, 1);
-		if (streq(type, t)) {
-			void* data = * (void**) lua_touserdata(L, -1);
-			result |= callback(data, callback_arg);
-		}
-
-		lua_pop(L, 1);
+	for (size_t i = 0; i < object_registry_count(type); i++) {
+		result |= callback(object_registry_get(type, i), callback_arg);
 	}
-	lua_pop(L, 1);
 	return result;
 }
 
 void dlua_call_init(void)
 {
-	if (dlua_get_function("init")) {
+	if (dlua_get_callback(CALLBACK_INIT)) {
 		call_lua_function(dlua.L, 0, 0);
 	}
 }
 
 void dlua_call_update(float dt)
 {
-	if (dlua_get_function("update")) {
+	if (dlua_get_callback(CALLBACK_UPDATE)) {
 		lua_State *L = dlua.L;
 		lua_pushnumber(L, dt);
 		call_lua_function(L, 1, 0);
 	}
 }
 
-void dlua_call_draw(void)
+void dlua_call_draw(float alpha)
 {
-	if (dlua_get_function("draw")) {
-		call_lua_function(dlua.L, 0, 0);
+	if (dlua_get_callback(CALLBACK_DRAW)) {
+		lua_State *L = dlua.L;
+		lua_pushnumber(L, alpha);
+		call_lua_function(L, 1, 0);
 	}
 }
 
 void dlua_call_atexit(void)
 {
-	if (dlua_get_function("atexit")) {
+	if (dlua_get_callback(CALLBACK_ATEXIT)) {
 		call_lua_function(dlua.L, 0, 0);
 	}
 }
@@ -284,6 +430,8 @@ bool dlua_reload_code(void)
 	call_lua_function(L, 0, 1);
 	bool ok = lua_toboolean(L, -1);
 	lua_pop(L, 1);
+	// prereload and postreload can also set callbacks
+	move_raw_callbacks();
 	return ok;
 }
 
@@ -293,6 +441,207 @@ static int mlua_stop(_unused_ lua_State *L)
 	return 0;
 }
 
+static int mlua_set_update_step(lua_State *L)
+{
+	lua_Number step = luaL_checknumber(L, 1);
+	lua_Integer max_steps = luaL_optinteger(L, 2, ENGINE_DEFAULT_MAX_UPDATE_STEPS);
+
+	assert_lua_error(L, step >= 0, "set_update_step: step must be >= 0");
+	assert_lua_error(L, max_steps > 0, "set_update_step: max_steps must be > 0");
+
+	engine_set_update_step(step, max_steps);
+	return 0;
+}
+
+static void set_seconds_field(lua_State *L, const char *name, unsigned long duration)
+{
+	lua_pushnumber(L, duration / (lua_Number) USEC_PER_SEC);
+	lua_setfield(L, -2, name);
+}
+
+static int mlua_get_frame_stats(lua_State *L)
+{
+	const FrameStats *stats = engine_get_frame_stats();
+
+	lua_newtable(L);
+	lua_pushinteger(L, stats->count);
+	lua_setfield(L, -2, "frames");
+	set_seconds_field(L, "mean", stats->count ? stats->total / stats->count : 0);
+	set_seconds_field(L, "min", stats->min);
+	set_seconds_field(L, "max", stats->max);
+	set_seconds_field(L, "p50", frame_stats_percentile(stats, 50));
+	set_seconds_field(L, "p90", frame_stats_percentile(stats, 90));
+	set_seconds_field(L, "p99", frame_stats_percentile(stats, 99));
+	set_seconds_field(L, "bucket_width", FRAME_STATS_BUCKET_WIDTH);
+
+	lua_createtable(L, FRAME_STATS_BUCKETS, 0);
+	for (int i = 0; i < FRAME_STATS_BUCKETS; i++) {
+		lua_pushinteger(L, stats->buckets[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_setfield(L, -2, "histogram");
+	return 1;
+}
+
+static int mlua_reset_frame_stats(_unused_ lua_State *L)
+{
+	engine_reset_frame_stats();
+	return 0;
+}
+
+static void push_gc_sentinel(lua_State *L);
+
+/*
+ * The sentinel is garbage, so its finalizer runs at the end of every
+ * collection cycle. It records the cycle and creates a new sentinel.
+ */
+static int gc_sentinel_gc(lua_State *L)
+{
+	dlua.gc_sentinel_alive = false;
+	if (!profiler_running)
+		return 0;
+
+	unsigned long now = profiler_now();
+	profiler_record("gc_cycle", now, now);
+	push_gc_sentinel(L);
+	lua_pop(L, 1);
+	return 0;
+}
+
+static void push_gc_sentinel(lua_State *L)
+{
+	dlua.gc_sentinel_alive = true;
+	lua_newuserdata(L, 1);
+	if (luaL_newmetatable(L, "__gc_sentinel")) {
+		lua_pushcfunction(L, gc_sentinel_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+}
+
+static int mlua_profiler_start(lua_State *L)
+{
+	profiler_start();
+	dlua_trace_allocations(true);
+	if (!dlua.gc_sentinel_alive) {
+		push_gc_sentinel(L);
+		lua_pop(L, 1);
+	}
+	return 0;
+}
+
+static int mlua_profiler_stop(lua_State *L)
+{
+	const char *filename = luaL_checkstring(L, 1);
+	int r;
+
+	assert_lua_error(L, profiler_running, "profiler_stop: the profiler is not running");
+
+	dlua_trace_allocations(false);
+	profiler_stop();
+	r = profiler_write_trace(filename);
+	if (r < 0) {
+		errno = -r;
+		return luaL_fileresult(L, 0, filename);
+	}
+	lua_pushboolean(L, true);
+	return 1;
+}
+
+static int mlua_lua_profiler_start(lua_State *L)
+{
+	lua_Number interval = luaL_optnumber(L, 1, LUA_PROFILER_DEFAULT_INTERVAL / 1e6);
+
+	assert_lua_error(L, interval > 0, "lua_profiler_start: interval must be > 0");
+
+	lua_profiler_start(dlua.L, interval * 1e6 < 1 ? 1 : interval * 1e6);
+	return 0;
+}
+
+static int mlua_lua_profiler_stop(lua_State *L)
+{
+	const char *filename = luaL_checkstring(L, 1);
+	int r;
+
+	assert_lua_error(L, lua_profiler_is_running(), "lua_profiler_stop: the Lua profiler is not running");
+
+	lua_profiler_stop();
+	r = lua_profiler_write(filename);
+	if (r < 0) {
+		errno = -r;
+		return luaL_fileresult(L, 0, filename);
+	}
+	lua_pushinteger(L, lua_profiler_get_samples());
+	return 1;
+}
+
+static void set_integer_field(lua_State *L, const char *name, lua_Integer value)
+{
+	lua_pushinteger(L, value);
+	lua_setfield(L, -2, name);
+}
+
+static int mlua_memory_stats(lua_State *L)
+{
+	LuaAllocatorStats stats;
+
+	lua_allocator_get_stats(dlua.allocator, &stats);
+
+	lua_newtable(L);
+	set_integer_field(L, "live_bytes", stats.live_bytes);
+	set_integer_field(L, "peak_bytes", stats.peak_bytes);
+	set_integer_field(L, "slab_bytes", stats.slab_bytes);
+	set_integer_field(L, "allocations", stats.allocations);
+	set_integer_field(L, "frees", stats.frees);
+	set_integer_field(L, "frame_allocations", stats.frame_allocations);
+	set_integer_field(L, "frame_allocated_bytes", stats.frame_allocated_bytes);
+	set_integer_field(L, "allocated_bytes", stats.allocated_bytes);
+	return 1;
+}
+
+static int mlua_object_counts(lua_State *L)
+{
+	lua_createtable(L, 0, OBJECT_TYPE_COUNT);
+	for (int i = 0; i < OBJECT_TYPE_COUNT; i++)
+		set_integer_field(L, OBJECT_TYPE_NAMES[i], object_registry_count(i));
+	return 1;
+}
+
+static int mlua_set_gc_budget(lua_State *L)
+{
+	lua_Number budget = luaL_checknumber(L, 1);
+	bool stop_automatic = lua_toboolean(L, 2);
+
+	assert_lua_error(L, budget >= 0, "set_gc_budget: budget must be >= 0");
+
+	engine_set_gc_budget(budget * USEC_PER_SEC, stop_automatic);
+	return 0;
+}
+
+static int mlua_gc_stats(lua_State *L)
+{
+	GcStats stats;
+
+	engine_get_gc_stats(&stats);
+
+	lua_newtable(L);
+	set_seconds_field(L, "frame_time", stats.frame_time);
+	set_integer_field(L, "frame_steps", stats.frame_steps);
+	set_seconds_field(L, "total_time", stats.total_time);
+	set_integer_field(L, "cycles", stats.cycles);
+	return 1;
+}
+
+static int mlua_collect_garbage(lua_State *L)
+{
+	lua_Number duration = luaL_optnumber(L, 1, 0);
+
+	assert_lua_error(L, duration >= 0, "collect_garbage: duration must be >= 0");
+
+	engine_collect_garbage_for(duration * USEC_PER_SEC);
+	return 0;
+}
+
 static int mlua_log_error(lua_State *L)
 {
 	const char* str = luaL_checkstring(L, 1);
@@ -358,7 +707,7 @@ static int mlua_reload_sound(lua_State *L)
 	assert(L);
 
 	const char* filename = luaL_checkstring(L, 1);
-	bool done = dlua_foreach("sound", reload_sound, filename);
+	bool done = dlua_foreach(OBJECT_SOUND, reload_sound, filename);
 	lua_pushboolean(L, done);
 	return 1;
 }
@@ -401,15 +750,47 @@ static int mlua_reload_surface(lua_State *L)
 	assert(L);
 
 	const char* filename = luaL_checkstring(L, 1);
-	bool done = dlua_foreach("surface", reload_surface, filename);
+	bool done = dlua_foreach(OBJECT_SURFACE, reload_surface, filename);
 	lua_pushboolean(L, done);
 	return 1;
 }
 #endif
 #endif
 
-static int mlua_drystal_index(_unused_ lua_State *L)
+// returns the callback named by the key at index, or -1
+static int callback_from_key(lua_State *L, int index)
+{
+	int callback = -1;
+
+	// the upvalue maps the names to the callbacks
+	lua_pushvalue(L, index);
+	lua_rawget(L, lua_upvalueindex(1));
+	if (lua_isinteger(L, -1))
+		callback = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	return callback;
+}
+
+static int mlua_drystal_newindex(lua_State *L)
 {
+	int callback = callback_from_key(L, 2);
+
+	if (callback >= 0) {
+		set_callback(L, callback, 3);
+		return 0;
+	}
+	lua_rawset(L, 1);
+	return 0;
+}
+
+static int mlua_drystal_index(lua_State *L)
+{
+	int callback = callback_from_key(L, 2);
+
+	if (callback >= 0) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, dlua.callback_refs[callback]);
+		return 1;
+	}
 #ifdef BUILD_GRAPHICS
 	int r;
 
@@ -434,11 +815,23 @@ int luaopen_drystal(lua_State *L)
 
 	static const luaL_Reg lib[] = {
 		{"stop", mlua_stop},
+		{"set_update_step", mlua_set_update_step},
+		{"get_frame_stats", mlua_get_frame_stats},
+		{"reset_frame_stats", mlua_reset_frame_stats},
+		{"memory_stats", mlua_memory_stats},
+		{"object_counts", mlua_object_counts},
+		{"set_gc_budget", mlua_set_gc_budget},
+		{"gc_stats", mlua_gc_stats},
+		{"collect_garbage", mlua_collect_garbage},
 		{"log_error", mlua_log_error},
 		{"log_warning", mlua_log_warning},
 		{"log_info", mlua_log_info},
 		{"log_debug", mlua_log_debug},
 		{"_load_code", mlua_load_code},
+		{"profiler_start", mlua_profiler_start},
+		{"profiler_stop", mlua_profiler_stop},
+		{"lua_profiler_start", mlua_lua_profiler_start},
+		{"lua_profiler_stop", mlua_lua_profiler_stop},
 #ifdef BUILD_LIVECODING
 #ifdef BUILD_AUDIO
 		{"reload_sound", mlua_reload_sound},
@@ -453,8 +846,16 @@ int luaopen_drystal(lua_State *L)
 	luaL_newlib(L, lib);
 
 	luaL_newmetatable(L, "_drystal");
-	lua_pushcfunction(L, mlua_drystal_index);
-	lua_setfield(L, -2, "__index");
+	lua_createtable(L, 0, CALLBACK_COUNT);
+	for (int i = 0; i < CALLBACK_COUNT; i++) {
+		lua_pushinteger(L, i);
+		lua_setfield(L, -2, DLUA_CALLBACK_NAMES[i]);
+	}
+	lua_pushvalue(L, -1);
+	lua_pushcclosure(L, mlua_drystal_index, 1);
+	lua_setfield(L, -3, "__index");
+	lua_pushcclosure(L, mlua_drystal_newindex, 1);
+	lua_setfield(L, -2, "__newindex");
 	lua_setmetatable(L, -2);
 
 	lua_pushvalue(L, -1);
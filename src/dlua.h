@@ -23,6 +23,33 @@ extern "C" {
 #include <stdbool.h>
 #include <lua.h>
 
+#include "object_registry.h"
+
+/*
+ * Callbacks called by the engine. They are stored in C so that calling them
+ * does not look up their name in the drystal table.
+ */
+enum DluaCallback {
+	CALLBACK_INIT,
+	CALLBACK_UPDATE,
+	CALLBACK_DRAW,
+	CALLBACK_ATEXIT,
+	CALLBACK_EVENTS,
+	CALLBACK_MOUSE_MOTION,
+	CALLBACK_MOUSE_PRESS,
+	CALLBACK_MOUSE_RELEASE,
+	CALLBACK_KEY_PRESS,
+	CALLBACK_KEY_RELEASE,
+	CALLBACK_KEY_TEXT,
+	CALLBACK_PAGE_RESIZE,
+	CALLBACK_ON_WGET_SUCCESS,
+	CALLBACK_ON_WGET_ERROR,
+	CALLBACK_COUNT,
+};
+typedef enum DluaCallback DluaCallback;
+
+extern const char *DLUA_CALLBACK_NAMES[CALLBACK_COUNT];
+
 void dlua_init(const char *filename);
 void dlua_add_arg(const char*);
 
@@ -33,13 +60,23 @@ bool dlua_reload_code(void);
 
 void dlua_call_init(void);
 void dlua_call_update(float dt);
-void dlua_call_draw(void);
+void dlua_call_draw(float alpha);
 void dlua_call_atexit(void);
-bool dlua_foreach(const char* type, bool(*callback)(void* data, const void* callback_arg), const void* callback_arg);
+bool dlua_foreach(ObjectType type, bool(*callback)(void* data, const void* callback_arg), const void* callback_arg);
 
 void dlua_get_drystal_field(const char* name);
 bool dlua_get_function(const char* name);
+// like dlua_get_function, without looking up the name
+bool dlua_get_callback(DluaCallback callback);
 void dlua_free(void);
+// returns true at the end of a collection cycle, kbytes is the size of the step
+// as for LUA_GCSTEP, 0 for a basic step
+bool dlua_gc_step(size_t kbytes);
+void dlua_set_gc_automatic(bool automatic);
+// since the start
+size_t dlua_get_allocated_bytes(void);
+// resets the per-frame memory stats
+void dlua_end_frame(void);
 
 #ifdef __cplusplus
 }
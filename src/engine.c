@@ -14,6 +14,8 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <time.h>
 #ifdef BUILD_GRAPHICS
@@ -25,6 +27,10 @@
 #endif
 
 #include "engine.h"
+#include "benchmark.h"
+#include "frame_stats.h"
+#include "job_pool.h"
+#include "profiler.h"
 #include "log.h"
 #ifdef BUILD_AUDIO
 #include "audio/audio.h"
@@ -48,14 +54,41 @@
 
 log_category("engine");
 
+// nanosleep can overshoot, the end of the wait is busy
+#define SPIN_DURATION 1000 // microseconds
+
 static struct Engine {
-	unsigned long target_ms_per_frame;
+	unsigned long target_frame_duration;
 	bool run;
 	bool loaded;
 	long unsigned last_update;
 
+	// 0 to call update once per frame with the elapsed time
+	float update_step;
+	unsigned int max_update_steps;
+	float update_accumulator;
+	FrameStats frame_stats;
+
+	unsigned long gc_budget;
+	bool gc_stop_automatic;
+	// allocated bytes already paid by the collector, see engine_collect_garbage
+	size_t gc_paid_bytes;
+	GcStats gc_stats;
+
 	bool update_activated;
 	bool draw_activated;
+
+	unsigned long frame;
+	unsigned long max_frames;
+	float fixed_dt;
+	Benchmark *benchmark;
+	char *benchmark_filename;
+	unsigned long phase_durations[BENCHMARK_PHASE_COUNT];
+#ifdef BUILD_GRAPHICS
+	char *dump_directory;
+	unsigned long *dump_frames;
+	size_t dump_frames_count;
+#endif
 #ifdef BUILD_LIVECODING
 	bool wait_next_reload;
 #define QUEUE_SIZE 128
@@ -77,14 +110,34 @@ static long unsigned get_now()
 static void engine_reload_queue(void);
 #endif
 
-int engine_init(const char* filename, unsigned int target_fps)
+int engine_init(const char* filename, unsigned int target_fps, _unused_ bool headless)
 {
-	engine.target_ms_per_frame = 1000 / target_fps;
+	assert(target_fps > 0);
+
+	engine.target_frame_duration = USEC_PER_SEC / target_fps;
 	engine.run = true;
 	engine.loaded = false;
 	engine.last_update = get_now();
+	engine.update_step = 0;
+	engine.max_update_steps = ENGINE_DEFAULT_MAX_UPDATE_STEPS;
+	engine.update_accumulator = 0;
+	frame_stats_reset(&engine.frame_stats);
+	engine.gc_budget = 0;
+	engine.gc_stop_automatic = false;
+	engine.gc_paid_bytes = 0;
+	memset(&engine.gc_stats, 0, sizeof(engine.gc_stats));
 	engine.update_activated = true;
 	engine.draw_activated = true;
+	engine.frame = 0;
+	engine.max_frames = 0;
+	engine.fixed_dt = 0;
+	engine.benchmark = NULL;
+	engine.benchmark_filename = NULL;
+#ifdef BUILD_GRAPHICS
+	engine.dump_directory = NULL;
+	engine.dump_frames = NULL;
+	engine.dump_frames_count = 0;
+#endif
 #ifdef BUILD_LIVECODING
 	engine.wait_next_reload = false;
 #endif
@@ -97,7 +150,7 @@ int engine_init(const char* filename, unsigned int target_fps)
 		return r;
 	}
 
-	r = display_init();
+	r = display_init(headless);
 	if (r < 0) {
 		return r;
 	}
@@ -113,7 +166,13 @@ int engine_init(const char* filename, unsigned int target_fps)
 
 void engine_free(void)
 {
+	benchmark_free(engine.benchmark);
+	engine.benchmark = NULL;
+	free(engine.benchmark_filename);
+	engine.benchmark_filename = NULL;
+
 	dlua_free();
+	job_pool_free();
 #ifdef BUILD_AUDIO
 	audio_free();
 #endif
@@ -121,9 +180,187 @@ void engine_free(void)
 	event_destroy();
 	display_free();
 	SDL_Quit();
+	free(engine.dump_directory);
+	free(engine.dump_frames);
 #endif
 }
 
+void engine_set_max_frames(unsigned long frames)
+{
+	engine.max_frames = frames;
+}
+
+void engine_set_fixed_dt(float dt)
+{
+	assert(dt >= 0);
+
+	engine.fixed_dt = dt;
+}
+
+void engine_set_update_step(float step, unsigned int max_steps)
+{
+	assert(step >= 0);
+	assert(max_steps > 0);
+
+	engine.update_step = step;
+	engine.max_update_steps = max_steps;
+	engine.update_accumulator = 0;
+}
+
+const FrameStats *engine_get_frame_stats(void)
+{
+	return &engine.frame_stats;
+}
+
+void engine_reset_frame_stats(void)
+{
+	frame_stats_reset(&engine.frame_stats);
+}
+
+void engine_set_gc_budget(unsigned long budget, bool stop_automatic)
+{
+	engine.gc_budget = budget;
+	engine.gc_stop_automatic = budget > 0 && stop_automatic;
+	engine.gc_paid_bytes = dlua_get_allocated_bytes();
+	dlua_set_gc_automatic(!engine.gc_stop_automatic);
+}
+
+void engine_get_gc_stats(GcStats *stats)
+{
+	assert(stats);
+
+	*stats = engine.gc_stats;
+}
+
+static void engine_collect_garbage(unsigned long deadline)
+{
+	unsigned long start = get_now();
+	unsigned long now = start;
+
+	engine.gc_stats.frame_time = 0;
+	engine.gc_stats.frame_steps = 0;
+	if (!engine.gc_budget)
+		return;
+
+	/*
+	 * Without the automatic collector, the first step does the work it would
+	 * have done for the bytes allocated since the previous frame, even in a
+	 * frame without idle time, so the collector keeps up with the game.
+	 */
+	bool force_step = engine.gc_stop_automatic;
+	size_t step_kbytes = 0;
+	if (force_step) {
+		step_kbytes = (dlua_get_allocated_bytes() - engine.gc_paid_bytes) / 1024;
+		engine.gc_paid_bytes += step_kbytes * 1024;
+	}
+
+	// at most one cycle per frame, the next one would start right away
+	while (now < deadline || force_step) {
+		force_step = false;
+		bool finished = dlua_gc_step(step_kbytes);
+		step_kbytes = 0;
+		engine.gc_stats.frame_steps++;
+		now = get_now();
+		if (finished) {
+			engine.gc_stats.cycles++;
+			break;
+		}
+	}
+
+	engine.gc_stats.frame_time = now - start;
+	engine.gc_stats.total_time += now - start;
+	if (profiler_running)
+		profiler_record("gc_steps", start, now);
+}
+
+void engine_collect_garbage_for(unsigned long duration)
+{
+	engine_collect_garbage(get_now() + duration);
+}
+
+void engine_enable_benchmark(const char *filename)
+{
+	assert(filename);
+
+	free(engine.benchmark_filename);
+	engine.benchmark_filename = xstrdup(filename);
+	if (!engine.benchmark)
+		engine.benchmark = benchmark_new();
+}
+
+int engine_write_benchmark(void)
+{
+	int r;
+
+	if (!engine.benchmark)
+		return 0;
+
+	r = benchmark_write_json(engine.benchmark, engine.benchmark_filename, engine.fixed_dt);
+	if (r < 0)
+		log_error("Cannot write the benchmark to '%s': %s", engine.benchmark_filename, strerror(-r));
+	return r;
+}
+
+static bool engine_is_deterministic(void)
+{
+	return engine.fixed_dt > 0 || engine.benchmark;
+}
+
+// adds the time elapsed since *start to the phase, and restarts *start
+static void engine_end_phase(BenchmarkPhase phase, unsigned long *start)
+{
+	unsigned long now;
+
+	if (!engine.benchmark && !profiler_running)
+		return;
+
+	now = get_now();
+	engine.phase_durations[phase] = now - *start;
+	if (profiler_running)
+		profiler_record(BENCHMARK_PHASE_NAMES[phase], *start, now);
+	*start = now;
+}
+
+#ifdef BUILD_GRAPHICS
+int engine_dump_frames(const char *directory, unsigned long *frames, size_t count)
+{
+	int r;
+
+	assert(directory);
+	assert(frames || !count);
+
+	r = mkdir_p(directory);
+	if (r < 0) {
+		log_error("Cannot create the directory '%s': %s", directory, strerror(-r));
+		free(frames);
+		return r;
+	}
+
+	free(engine.dump_directory);
+	free(engine.dump_frames);
+	engine.dump_directory = xstrdup(directory);
+	engine.dump_frames = frames;
+	engine.dump_frames_count = count;
+	return 0;
+}
+
+static void engine_dump_frame_if_needed(void)
+{
+	for (size_t i = 0; i < engine.dump_frames_count; i++) {
+		if (engine.dump_frames[i] == engine.frame) {
+			char name[32];
+			snprintf(name, sizeof(name), "frame-%06lu.png", engine.frame);
+			char *path = strjoin(engine.dump_directory, "/", name, NULL);
+			int r = display_save_surface(display_get_screen(), path);
+			if (r < 0)
+				log_error("Cannot save the frame to '%s': %s", path, strerror(-r));
+			free(path);
+			return;
+		}
+	}
+}
+#endif
+
 bool engine_is_loaded(void)
 {
 	return engine.loaded;
@@ -151,31 +388,115 @@ void engine_load(void)
 	engine.loaded = true;
 }
 
+#ifndef EMSCRIPTEN
+static void engine_wait_until(unsigned long deadline)
+{
+	unsigned long now = get_now();
+
+	if (now + SPIN_DURATION < deadline) {
+		unsigned long duration = deadline - SPIN_DURATION - now;
+		struct timespec ts;
+
+		ts.tv_sec = duration / USEC_PER_SEC;
+		ts.tv_nsec = (duration % USEC_PER_SEC) * NSEC_PER_USEC;
+		while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+			;
+	}
+
+	while (get_now() < deadline)
+		;
+}
+
+#ifdef BUILD_GRAPHICS
+static bool engine_is_paced_by_vsync(unsigned long frame_duration)
+{
+	if (!display_is_paced_by_vsync())
+		return false;
+
+	// the driver may ignore the swap interval, or not block while the window is hidden:
+	// a frame (without the wait) well under the refresh period was not paced,
+	// the deadlines take over
+	unsigned long refresh_period = display_get_refresh_period();
+	if (!refresh_period)
+		refresh_period = engine.target_frame_duration;
+	return frame_duration * 2 >= refresh_period;
+}
+#endif
+#endif
+
 void engine_loop(void)
 {
 #ifndef EMSCRIPTEN
+	unsigned long next_frame = get_now();
+
 	while (engine.run) {
-		unsigned long at_start = get_now();
+		_unused_ unsigned long frame_start = get_now();
 
 		// update everything (event, game, display)
 		engine_update();
 
-		// wait few millis to stay at the targeted fps value
-		unsigned long ms_per_frame = (get_now() - at_start) / 1000;
-		if (ms_per_frame < engine.target_ms_per_frame) {
-			unsigned long sleep_time = engine.target_ms_per_frame - ms_per_frame;
-			if (sleep_time > 0) {
-				msleep(sleep_time);
-			}
+		unsigned long now = get_now();
+
+		// benchmarks run as fast as possible, and vsync already waits in display_flip
+#ifdef BUILD_GRAPHICS
+		if (engine_is_deterministic() || engine_is_paced_by_vsync(now - frame_start)) {
+#else
+		if (engine_is_deterministic()) {
+#endif
+			engine_collect_garbage(now + engine.gc_budget);
+			next_frame = get_now();
+			continue;
+		}
+
+		// frames are scheduled on absolute deadlines, so the errors do not accumulate
+		next_frame += engine.target_frame_duration;
+		if (now > next_frame + engine.target_frame_duration) {
+			// too late, do not try to catch up
+			engine_collect_garbage(now + engine.gc_budget);
+			next_frame = get_now();
+		} else {
+			// the garbage collector uses the idle time first
+			unsigned long gc_deadline = now + engine.gc_budget;
+			engine_collect_garbage(gc_deadline < next_frame ? gc_deadline : next_frame);
+			engine_wait_until(next_frame);
 		}
 	}
 #endif
 }
 
+// calls update with fixed steps if needed, returns the interpolation factor for draw
+static float engine_call_update(float dt)
+{
+	if (engine.update_step <= 0) {
+		dlua_call_update(dt);
+		return 1;
+	}
+
+	// drop the time that cannot be caught up with max_update_steps
+	engine.update_accumulator += dt;
+	if (engine.update_accumulator > engine.update_step * engine.max_update_steps)
+		engine.update_accumulator = engine.update_step * engine.max_update_steps;
+
+	while (engine.update_accumulator >= engine.update_step && engine.run) {
+		dlua_call_update(engine.update_step);
+		engine.update_accumulator -= engine.update_step;
+	}
+	return engine.update_accumulator / engine.update_step;
+}
+
 void engine_update(void)
 {
-	float dt = (get_now() - engine.last_update) / (float) USEC_PER_SEC;
-	engine.last_update = get_now();
+	unsigned long frame_start = get_now();
+	unsigned long phase_start = frame_start;
+	float dt = (frame_start - engine.last_update) / (float) USEC_PER_SEC;
+	float alpha = 1;
+
+	// the first frame would count the loading time
+	if (engine.frame > 0)
+		frame_stats_add(&engine.frame_stats, frame_start - engine.last_update);
+	engine.last_update = frame_start;
+	if (engine.fixed_dt > 0)
+		dt = engine.fixed_dt;
 
 #ifdef BUILD_LIVECODING
 	if (livecoding_is_running()) {
@@ -189,8 +510,11 @@ void engine_update(void)
 	}
 #endif
 
+	memset(engine.phase_durations, 0, sizeof(engine.phase_durations));
+
 #ifdef BUILD_GRAPHICS
 	event_update();
+	engine_end_phase(BENCHMARK_EVENTS, &phase_start);
 #endif
 
 	// check if an event provocked a stop
@@ -199,16 +523,38 @@ void engine_update(void)
 
 #ifdef BUILD_AUDIO
 	audio_update(dt);
+	engine_end_phase(BENCHMARK_AUDIO, &phase_start);
 #endif
 
 	if (engine.update_activated)
-		dlua_call_update(dt);
+		alpha = engine_call_update(dt);
+	engine_end_phase(BENCHMARK_UPDATE, &phase_start);
 
 	if (engine.draw_activated)
-		dlua_call_draw();
+		dlua_call_draw(alpha);
+	engine_end_phase(BENCHMARK_DRAW, &phase_start);
 
 #ifdef BUILD_GRAPHICS
 	display_flip();
+	engine_end_phase(BENCHMARK_FLIP, &phase_start);
+#endif
+
+	dlua_end_frame();
+	engine.frame++;
+	phase_start = frame_start;
+	engine_end_phase(BENCHMARK_FRAME, &phase_start);
+	if (engine.benchmark)
+		benchmark_add_frame(engine.benchmark, engine.phase_durations);
+#ifdef BUILD_GRAPHICS
+	engine_dump_frame_if_needed();
+#endif
+
+	if (engine.max_frames > 0 && engine.frame >= engine.max_frames && engine.run)
+		engine_stop();
+
+#ifdef EMSCRIPTEN
+	// the browser schedules the frames, see engine_loop
+	engine_collect_garbage(get_now() + engine.gc_budget);
 #endif
 }
 
@@ -17,8 +17,13 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
-int engine_init(const char *filename, unsigned int target_fps);
+#include "frame_stats.h"
+
+#define ENGINE_DEFAULT_MAX_UPDATE_STEPS 5
+
+int engine_init(const char *filename, unsigned int target_fps, bool headless);
 void engine_free(void);
 void engine_load(void);
 void engine_loop(void);
@@ -27,6 +32,46 @@ bool engine_is_loaded(void);
 void engine_stop(void);
 void engine_toggle_update(void);
 void engine_toggle_draw(void);
+// stops the engine after this number of frames, 0 for no limit
+void engine_set_max_frames(unsigned long frames);
+// uses dt for every update instead of the elapsed time, 0 to disable
+void engine_set_fixed_dt(float dt);
+/*
+ * Calls update with a dt of step seconds, as many times as needed to
+ * catch up with the elapsed time but at most max_steps times per frame.
+ * draw receives the remaining fraction of a step to interpolate.
+ * A step of 0 calls update once per frame with the elapsed time.
+ */
+void engine_set_update_step(float step, unsigned int max_steps);
+// durations between the starts of consecutive frames
+const FrameStats *engine_get_frame_stats(void);
+void engine_reset_frame_stats(void);
+typedef struct GcStats GcStats;
+
+struct GcStats {
+	// in microseconds
+	unsigned long frame_time;
+	unsigned long frame_steps;
+	unsigned long total_time;
+	unsigned long cycles;
+};
+
+/*
+ * Runs incremental steps of the Lua garbage collector after every frame,
+ * for at most budget microseconds and without delaying the next frame.
+ * With stop_automatic, the collector only runs there.
+ */
+void engine_set_gc_budget(unsigned long budget, bool stop_automatic);
+// the frame_* fields are about the last frame
+void engine_get_gc_stats(GcStats *stats);
+void engine_collect_garbage_for(unsigned long duration);
+// times every frame and its phases, without waiting between frames
+void engine_enable_benchmark(const char *filename);
+int engine_write_benchmark(void);
+#ifdef BUILD_GRAPHICS
+// frames are numbered from 1, the engine takes ownership of the array
+int engine_dump_frames(const char *directory, unsigned long *frames, size_t count);
+#endif
 #ifdef BUILD_LIVECODING
 void engine_wait_next_reload(void);
 void engine_add_file_to_reloadqueue(const char* filename);
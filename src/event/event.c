@@ -35,6 +35,13 @@ log_category("event");
 
 static int keys_table_ref;
 
+/*
+ * When drystal.events is defined, the events of a frame are appended to
+ * this table (at this index of the Lua stack) and delivered in one call.
+ */
+static int batch_index = 0;
+static lua_Integer batch_count;
+
 static void initialize_keys_mapping(void)
 {
 	lua_State *L = dlua_get_lua_state();
@@ -192,10 +199,40 @@ static void push_keyname(lua_State *L, SDL_Keycode key)
 	}
 }
 
+// pushes a new event table if the events are batched
+static bool push_batched_event(lua_State *L, const char *type)
+{
+	if (!batch_index)
+		return false;
+
+	lua_createtable(L, 0, 5);
+	lua_pushstring(L, type);
+	lua_setfield(L, -2, "type");
+	return true;
+}
+
+static void set_number_field(lua_State *L, const char *name, lua_Number value)
+{
+	lua_pushnumber(L, value);
+	lua_setfield(L, -2, name);
+}
+
+static void add_batched_event(lua_State *L)
+{
+	lua_rawseti(L, batch_index, ++batch_count);
+}
+
 static void call_mouse_motion(int mx, int my, int dx, int dy)
 {
-	if (dlua_get_function("mouse_motion")) {
-		lua_State* L = dlua_get_lua_state();
+	lua_State* L = dlua_get_lua_state();
+
+	if (push_batched_event(L, "mouse_motion")) {
+		set_number_field(L, "x", mx);
+		set_number_field(L, "y", my);
+		set_number_field(L, "dx", dx);
+		set_number_field(L, "dy", dy);
+		add_batched_event(L);
+	} else if (dlua_get_callback(CALLBACK_MOUSE_MOTION)) {
 		lua_pushnumber(L, mx);
 		lua_pushnumber(L, my);
 		lua_pushnumber(L, dx);
@@ -206,8 +243,14 @@ static void call_mouse_motion(int mx, int my, int dx, int dy)
 
 static void call_mouse_press(int mx, int my, Button button)
 {
-	if (dlua_get_function("mouse_press")) {
-		lua_State* L = dlua_get_lua_state();
+	lua_State* L = dlua_get_lua_state();
+
+	if (push_batched_event(L, "mouse_press")) {
+		set_number_field(L, "x", mx);
+		set_number_field(L, "y", my);
+		set_number_field(L, "button", button);
+		add_batched_event(L);
+	} else if (dlua_get_callback(CALLBACK_MOUSE_PRESS)) {
 		lua_pushnumber(L, mx);
 		lua_pushnumber(L, my);
 		lua_pushnumber(L, button);
@@ -217,8 +260,14 @@ static void call_mouse_press(int mx, int my, Button button)
 
 static void call_mouse_release(int mx, int my, Button button)
 {
-	if (dlua_get_function("mouse_release")) {
-		lua_State* L = dlua_get_lua_state();
+	lua_State* L = dlua_get_lua_state();
+
+	if (push_batched_event(L, "mouse_release")) {
+		set_number_field(L, "x", mx);
+		set_number_field(L, "y", my);
+		set_number_field(L, "button", button);
+		add_batched_event(L);
+	} else if (dlua_get_callback(CALLBACK_MOUSE_RELEASE)) {
 		lua_pushnumber(L, mx);
 		lua_pushnumber(L, my);
 		lua_pushnumber(L, button);
@@ -228,8 +277,13 @@ static void call_mouse_release(int mx, int my, Button button)
 
 static void call_key_press(SDL_Keycode key)
 {
-	if (dlua_get_function("key_press")) {
-		lua_State* L = dlua_get_lua_state();
+	lua_State* L = dlua_get_lua_state();
+
+	if (push_batched_event(L, "key_press")) {
+		push_keyname(L, key);
+		lua_setfield(L, -2, "key");
+		add_batched_event(L);
+	} else if (dlua_get_callback(CALLBACK_KEY_PRESS)) {
 		push_keyname(L, key);
 		call_lua_function(L, 1, 0);
 	}
@@ -237,8 +291,13 @@ static void call_key_press(SDL_Keycode key)
 
 static void call_key_release(SDL_Keycode key)
 {
-	if (dlua_get_function("key_release")) {
-		lua_State* L = dlua_get_lua_state();
+	lua_State* L = dlua_get_lua_state();
+
+	if (push_batched_event(L, "key_release")) {
+		push_keyname(L, key);
+		lua_setfield(L, -2, "key");
+		add_batched_event(L);
+	} else if (dlua_get_callback(CALLBACK_KEY_RELEASE)) {
 		push_keyname(L, key);
 		call_lua_function(L, 1, 0);
 	}
@@ -246,10 +305,15 @@ static void call_key_release(SDL_Keycode key)
 
 static void call_key_text(const char* string)
 {
+	lua_State* L = dlua_get_lua_state();
+
 	assert(string);
 
-	if (dlua_get_function("key_text")) {
-		lua_State* L = dlua_get_lua_state();
+	if (push_batched_event(L, "key_text")) {
+		lua_pushstring(L, string);
+		lua_setfield(L, -2, "text");
+		add_batched_event(L);
+	} else if (dlua_get_callback(CALLBACK_KEY_TEXT)) {
 		lua_pushstring(L, string);
 		call_lua_function(L, 1, 0);
 	}
@@ -320,10 +384,26 @@ static void handle_event(SDL_Event event)
 
 void event_update()
 {
+	lua_State* L = dlua_get_lua_state();
 	SDL_Event event;
+
+	if (dlua_get_callback(CALLBACK_EVENTS)) {
+		lua_newtable(L);
+		batch_index = lua_gettop(L);
+		batch_count = 0;
+	}
+
 	while (SDL_PollEvent(&event)) {
 		handle_event(event);
 	}
+
+	if (batch_index) {
+		batch_index = 0;
+		if (batch_count > 0)
+			call_lua_function(L, 1, 0);
+		else
+			lua_pop(L, 2);
+	}
 }
 
 void event_small_update()
@@ -350,7 +430,7 @@ static EM_BOOL em_ui_callback(_unused_ int eventType, const EmscriptenUiEvent *u
 	int w = uiEvent->windowInnerWidth;
 	int h = uiEvent->windowInnerHeight;
 
-	if (dlua_get_function("page_resize")) {
+	if (dlua_get_callback(CALLBACK_PAGE_RESIZE)) {
 		lua_State* L = dlua_get_lua_state();
 		lua_pushnumber(L, w);
 		lua_pushnumber(L, h);
@@ -35,6 +35,7 @@ struct Font {
 	int first_char;
 	int num_chars;
 	int ref;
+	size_t registry_index; // see object_registry.h
 	stbtt_bakedchar* char_data;
 };
 
@@ -22,7 +22,7 @@
 #include "font_bind.h"
 #include "lua_util.h"
 
-IMPLEMENT_PUSHPOP(Font, font)
+IMPLEMENT_PUSHPOP(Font, font, OBJECT_FONT)
 
 int mlua_draw_font(lua_State* L)
 {
@@ -94,6 +94,7 @@ int mlua_free_font(lua_State* L)
 	assert(L);
 
 	Font* font = pop_font(L, 1);
+	object_registry_remove(OBJECT_FONT, &font->registry_index);
 	font_free(font);
 	return 0;
 }
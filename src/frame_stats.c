@@ -0,0 +1,71 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "frame_stats.h"
+
+void frame_stats_reset(FrameStats *s)
+{
+	assert(s);
+
+	memset(s, 0, sizeof(*s));
+}
+
+void frame_stats_add(FrameStats *s, unsigned long duration)
+{
+	unsigned long bucket = duration / FRAME_STATS_BUCKET_WIDTH;
+
+	assert(s);
+
+	if (bucket >= FRAME_STATS_BUCKETS)
+		bucket = FRAME_STATS_BUCKETS - 1;
+	s->buckets[bucket]++;
+
+	if (s->count == 0 || duration < s->min)
+		s->min = duration;
+	if (duration > s->max)
+		s->max = duration;
+	s->count++;
+	s->total += duration;
+}
+
+unsigned long frame_stats_percentile(const FrameStats *s, unsigned int p)
+{
+	unsigned long rank;
+	unsigned long seen = 0;
+
+	assert(s);
+	assert(p <= 100);
+
+	if (s->count == 0)
+		return 0;
+
+	// nearest-rank, as in benchmark.c
+	rank = (p * s->count + 99) / 100;
+	if (rank == 0)
+		rank = 1;
+
+	for (unsigned int i = 0; i < FRAME_STATS_BUCKETS; i++) {
+		seen += s->buckets[i];
+		if (seen >= rank) {
+			unsigned long upper = (i + 1) * FRAME_STATS_BUCKET_WIDTH;
+			return upper < s->max ? upper : s->max;
+		}
+	}
+	return s->max;
+}
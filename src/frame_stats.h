@@ -0,0 +1,39 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#define FRAME_STATS_BUCKETS 128
+#define FRAME_STATS_BUCKET_WIDTH 250 // microseconds
+
+typedef struct FrameStats FrameStats;
+
+/*
+ * Histogram of the frame durations, in buckets of FRAME_STATS_BUCKET_WIDTH.
+ * The last bucket also counts the longer frames.
+ */
+struct FrameStats {
+	unsigned long buckets[FRAME_STATS_BUCKETS];
+	unsigned long count;
+	unsigned long total;
+	unsigned long min;
+	unsigned long max;
+};
+
+void frame_stats_reset(FrameStats *s);
+void frame_stats_add(FrameStats *s, unsigned long duration);
+// upper bound of the bucket containing the p-th percentile, 0 without frames
+unsigned long frame_stats_percentile(const FrameStats *s, unsigned int p);
@@ -24,6 +24,7 @@
 #include "camera_bind.h"
 #include "shader_bind.h"
 #include "buffer_bind.h"
+#include "atlas_bind.h"
 #include "api.h"
 #include "util.h"
 
@@ -33,6 +34,7 @@ BEGIN_MODULE(graphics)
 	DECLARE_FUNCTION(resize)
 	DECLARE_FUNCTION(set_title)
 	DECLARE_FUNCTION(set_fullscreen)
+	DECLARE_FUNCTION(set_vsync)
 	DECLARE_FUNCTION(screen2scene)
 
 	/* DISPLAY SURFACE */
@@ -45,13 +47,19 @@ BEGIN_MODULE(graphics)
 	DECLARE_FUNCTION(draw_point_tex)
 	DECLARE_FUNCTION(draw_line)
 	DECLARE_FUNCTION(draw_triangle)
+	DECLARE_FUNCTION(draw_triangles)
 	DECLARE_FUNCTION(draw_surface)
 	DECLARE_FUNCTION(draw_quad)
+	DECLARE_FUNCTION(draw_quads)
 
 	/* DISPLAY SETTERS */
 	DECLARE_FUNCTION(set_color)
 	DECLARE_FUNCTION(set_alpha)
 	DECLARE_FUNCTION(set_blend_mode)
+	DECLARE_FUNCTION(set_premultiplied_alpha)
+	DECLARE_FUNCTION(set_texture_batching)
+
+	DECLARE_FUNCTION(get_render_stats)
 
 	BEGIN_CLASS(surface)
 		ADD_METHOD(surface, set_filter)
@@ -71,6 +79,12 @@ BEGIN_MODULE(graphics)
 	    ADD_GC(free_buffer)
 	REGISTER_CLASS(buffer, "Buffer")
 
+	DECLARE_FUNCTION(new_atlas)
+	BEGIN_CLASS(atlas)
+	    ADD_METHOD(atlas, add)
+	    ADD_GC(free_atlas)
+	REGISTER_CLASS(atlas, "Atlas")
+
 	DECLARE_FUNCTION(new_shader)
 	DECLARE_FUNCTION(use_default_shader)
 	BEGIN_CLASS(shader)
@@ -101,6 +115,12 @@ BEGIN_MODULE(graphics)
 		ADD_CONSTANT("trilinear", FILTER_TRILINEAR)
 	REGISTER_ENUM("filters")
 
+	BEGIN_ENUM()
+		ADD_CONSTANT("off", VSYNC_OFF)
+		ADD_CONSTANT("on", VSYNC_ON)
+		ADD_CONSTANT("adaptive", VSYNC_ADAPTIVE)
+	REGISTER_ENUM("vsyncs")
+
 	{
 		// camera
 		lua_newtable(L);
@@ -0,0 +1,215 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+#include "display.h"
+#include "util.h"
+
+Atlas *atlas_new(unsigned int w, unsigned int h)
+{
+	assert(w > 0);
+	assert(h > 0);
+
+	Atlas *a = new0(Atlas, 1);
+	a->w = w;
+	a->h = h;
+
+	return a;
+}
+
+void atlas_free(Atlas *a)
+{
+	if (!a)
+		return;
+
+	for (size_t i = 0; i < a->pages_count; i++)
+		free(a->pages[i].skyline);
+	free(a->pages);
+	free(a);
+}
+
+static void atlas_add_page(Atlas *a)
+{
+	assert(a);
+
+	XREALLOC(a->pages, a->pages_size, a->pages_count + 1);
+	AtlasPage *page = &a->pages[a->pages_count++];
+	page->surface = display_new_surface(a->w, a->h, false);
+	page->skyline = NULL;
+	page->skyline_size = 0;
+	XREALLOC(page->skyline, page->skyline_size, 1);
+	page->skyline[0].x = 0;
+	page->skyline[0].y = 0;
+	page->skyline[0].w = a->w;
+	page->skyline_count = 1;
+}
+
+/*
+ * Returns the lowest y where a rectangle of width w starting at the node
+ * i fits, or -1 if it doesn't fit.
+ */
+static int skyline_fit(const AtlasPage *page, size_t i, unsigned int w, unsigned int h,
+                       unsigned int page_w, unsigned int page_h)
+{
+	const SkylineNode *skyline = page->skyline;
+	unsigned int x = skyline[i].x;
+	unsigned int y = 0;
+	unsigned int remaining = w;
+
+	if (x + w > page_w)
+		return -1;
+
+	while (remaining > 0) {
+		assert(i < page->skyline_count);
+		if (skyline[i].y > y)
+			y = skyline[i].y;
+		if (y + h > page_h)
+			return -1;
+		remaining = skyline[i].w >= remaining ? 0 : remaining - skyline[i].w;
+		i++;
+	}
+	return y;
+}
+
+// bottom-left heuristic: lowest top edge, then narrowest node
+static bool skyline_find(const AtlasPage *page, unsigned int w, unsigned int h,
+                         unsigned int page_w, unsigned int page_h,
+                         size_t *best_index, unsigned int *best_y)
+{
+	unsigned int best_top = (unsigned int) -1;
+	unsigned int best_width = (unsigned int) -1;
+	bool found = false;
+
+	for (size_t i = 0; i < page->skyline_count; i++) {
+		int y = skyline_fit(page, i, w, h, page_w, page_h);
+		if (y < 0)
+			continue;
+
+		unsigned int top = y + h;
+		if (top < best_top || (top == best_top && page->skyline[i].w < best_width)) {
+			best_top = top;
+			best_width = page->skyline[i].w;
+			*best_index = i;
+			*best_y = y;
+			found = true;
+		}
+	}
+	return found;
+}
+
+static void skyline_insert(AtlasPage *page, size_t index, unsigned int y, unsigned int w, unsigned int h)
+{
+	SkylineNode *skyline;
+
+	XREALLOC(page->skyline, page->skyline_size, page->skyline_count + 1);
+	skyline = page->skyline;
+
+	memmove(skyline + index + 1, skyline + index, (page->skyline_count - index) * sizeof(SkylineNode));
+	page->skyline_count++;
+	skyline[index].y = y + h;
+	skyline[index].w = w;
+
+	// shrink or remove the nodes now covered by the new one
+	for (size_t i = index + 1; i < page->skyline_count; i++) {
+		unsigned int end = skyline[index].x + skyline[index].w;
+		if (skyline[i].x >= end)
+			break;
+
+		unsigned int shrink = end - skyline[i].x;
+		if (skyline[i].w > shrink) {
+			skyline[i].x += shrink;
+			skyline[i].w -= shrink;
+			break;
+		}
+		memmove(skyline + i, skyline + i + 1, (page->skyline_count - i - 1) * sizeof(SkylineNode));
+		page->skyline_count--;
+		i--;
+	}
+
+	// merge neighbours of the same height
+	for (size_t i = 0; i + 1 < page->skyline_count; i++) {
+		if (skyline[i].y == skyline[i + 1].y) {
+			skyline[i].w += skyline[i + 1].w;
+			memmove(skyline + i + 1, skyline + i + 2, (page->skyline_count - i - 2) * sizeof(SkylineNode));
+			page->skyline_count--;
+			i--;
+		}
+	}
+}
+
+static void atlas_upload(Surface *surface, const unsigned char *pixels,
+                         unsigned int x, unsigned int y, unsigned int w, unsigned int h)
+{
+	const Surface *current_from = display_get_draw_from();
+
+	glBindTexture(GL_TEXTURE_2D, surface->tex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glBindTexture(GL_TEXTURE_2D, current_from ? current_from->tex : 0);
+
+	surface->has_mipmap = false;
+	surface->pixels_valid = false;
+}
+
+int atlas_add(Atlas *a, const unsigned char *pixels, unsigned int w, unsigned int h,
+              AtlasRegion *region, bool *new_page)
+{
+	unsigned int padded_w = w + 2 * ATLAS_PADDING;
+	unsigned int padded_h = h + 2 * ATLAS_PADDING;
+	size_t index = 0;
+	unsigned int y = 0;
+	AtlasPage *page = NULL;
+
+	assert(a);
+	assert(pixels);
+	assert(region);
+	assert(new_page);
+
+	if (padded_w > a->w || padded_h > a->h)
+		return -E2BIG;
+
+	*new_page = false;
+	for (size_t i = 0; i < a->pages_count; i++) {
+		if (skyline_find(&a->pages[i], padded_w, padded_h, a->w, a->h, &index, &y)) {
+			page = &a->pages[i];
+			break;
+		}
+	}
+	if (!page) {
+		atlas_add_page(a);
+		page = &a->pages[a->pages_count - 1];
+		*new_page = true;
+
+		bool found = skyline_find(page, padded_w, padded_h, a->w, a->h, &index, &y);
+		assert(found);
+	}
+
+	unsigned int x = page->skyline[index].x;
+	skyline_insert(page, index, y, padded_w, padded_h);
+
+	region->surface = page->surface;
+	region->x = x + ATLAS_PADDING;
+	region->y = y + ATLAS_PADDING;
+	region->w = w;
+	region->h = h;
+	atlas_upload(page->surface, pixels, region->x, region->y, w, h);
+
+	return 0;
+}
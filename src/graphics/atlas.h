@@ -0,0 +1,72 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "surface.h"
+
+typedef struct Atlas Atlas;
+typedef struct AtlasPage AtlasPage;
+typedef struct AtlasRegion AtlasRegion;
+typedef struct SkylineNode SkylineNode;
+
+// empty pixels around each image, so linear filtering does not bleed
+#define ATLAS_PADDING 1
+
+struct SkylineNode {
+	unsigned int x;
+	unsigned int y;
+	unsigned int w;
+};
+
+struct AtlasPage {
+	Surface *surface;
+	SkylineNode *skyline;
+	size_t skyline_count;
+	size_t skyline_size;
+};
+
+struct Atlas {
+	unsigned int w;
+	unsigned int h;
+	AtlasPage *pages;
+	size_t pages_count;
+	size_t pages_size;
+	int ref;
+	size_t registry_index; // see object_registry.h
+};
+
+struct AtlasRegion {
+	Surface *surface;
+	unsigned int x;
+	unsigned int y;
+	unsigned int w;
+	unsigned int h;
+};
+
+Atlas *atlas_new(unsigned int w, unsigned int h);
+// the page surfaces are not freed, they belong to the caller
+void atlas_free(Atlas *a);
+
+/*
+ * Packs a w*h RGBA image in a page, creating a new page if needed.
+ * Returns -E2BIG if the image cannot fit in an empty page.
+ * new_page is set if region->surface has just been created.
+ */
+int atlas_add(Atlas *a, const unsigned char *pixels, unsigned int w, unsigned int h,
+              AtlasRegion *region, bool *new_page);
@@ -0,0 +1,121 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "atlas_bind.h"
+#include "display.h"
+#include "display_bind.h"
+#include "log.h"
+
+log_category("atlas");
+
+IMPLEMENT_PUSHPOP(Atlas, atlas, OBJECT_ATLAS)
+
+int mlua_new_atlas(lua_State* L)
+{
+	assert(L);
+
+	lua_Integer w = luaL_checkinteger(L, 1);
+	lua_Integer h = luaL_checkinteger(L, 2);
+
+	assert_lua_error(L, w > 0 && w <= 2048, "new_atlas: width must be > 0 and <= 2048");
+	assert_lua_error(L, h > 0 && h <= 2048, "new_atlas: height must be > 0 and <= 2048");
+
+	Atlas *atlas = atlas_new(w, h);
+	push_atlas(L, atlas);
+
+	// the pages are surfaces owned by lua, keep them alive with the atlas
+	lua_newtable(L);
+	lua_setfield(L, -2, "pages");
+	return 1;
+}
+
+int mlua_add_atlas(lua_State* L)
+{
+	assert(L);
+
+	Atlas *atlas = pop_atlas(L, 1);
+	AtlasRegion region;
+	bool new_page;
+	int r;
+
+	if (lua_type(L, 2) == LUA_TSTRING) {
+		const char *filename = lua_tostring(L, 2);
+		unsigned char *pixels;
+		unsigned int w, h;
+
+		r = surface_load_pixels(filename, &pixels, &w, &h, display_is_premultiplied_alpha());
+		if (r == 0) {
+			r = atlas_add(atlas, pixels, w, h, &region, &new_page);
+			free(pixels);
+		}
+	} else {
+		Surface *surface = pop_surface(L, 2);
+		assert_lua_error(L, surface != display_get_draw_on(), "add: cannot add the surface being drawn on");
+
+		const unsigned char *pixels = surface_get_pixels(surface, display_get_draw_on());
+		r = atlas_add(atlas, pixels, surface->w, surface->h, &region, &new_page);
+	}
+
+	if (r < 0) {
+		lua_pushnil(L);
+		if (r == -E2BIG) {
+			lua_pushliteral(L, "add: image is larger than the atlas");
+		} else if (r == -ENOTSUP) {
+			lua_pushliteral(L, "add: unsupported format");
+		} else if (r == -EBADMSG) {
+			lua_pushliteral(L, "add: not a PNG");
+		} else {
+			lua_pushfstring(L, "%s: %s", "add", strerror(-r));
+		}
+		return 2;
+	}
+
+	if (new_page) {
+		lua_getfield(L, 1, "pages");
+		push_surface(L, region.surface);
+		lua_rawseti(L, -2, lua_rawlen(L, -2) + 1);
+		lua_pop(L, 1);
+	}
+
+	lua_createtable(L, 0, 5);
+	lua_pushinteger(L, region.x);
+	lua_setfield(L, -2, "x");
+	lua_pushinteger(L, region.y);
+	lua_setfield(L, -2, "y");
+	lua_pushinteger(L, region.w);
+	lua_setfield(L, -2, "w");
+	lua_pushinteger(L, region.h);
+	lua_setfield(L, -2, "h");
+	push_surface(L, region.surface);
+	lua_setfield(L, -2, "surface");
+	return 1;
+}
+
+int mlua_free_atlas(lua_State* L)
+{
+	assert(L);
+
+	Atlas *atlas = pop_atlas(L, 1);
+	object_registry_remove(OBJECT_ATLAS, &atlas->registry_index);
+	atlas_free(atlas);
+	return 0;
+}
@@ -15,6 +15,7 @@
  * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <assert.h>
+#include <stddef.h>
 
 #include "buffer.h"
 #include "display.h"
@@ -22,9 +23,71 @@
 #include "util.h"
 #include "log.h"
 #include "opengl_util.h"
+#include "stats.h"
+#include "profiler.h"
 
 log_category("buffer");
 
+static GLuint quad_indices;
+static unsigned int quad_indices_users;
+
+static void buffer_ref_quad_indices(void)
+{
+	if (quad_indices_users++ > 0)
+		return;
+
+	size_t count = BUFFER_MAX_QUADS_PER_DRAW * BUFFER_INDICES_PER_QUAD;
+	GLushort *indices = new(GLushort, count);
+	for (size_t q = 0; q < BUFFER_MAX_QUADS_PER_DRAW; q++) {
+		GLushort first = q * BUFFER_VERTICES_PER_QUAD;
+		GLushort *i = indices + q * BUFFER_INDICES_PER_QUAD;
+		i[0] = first;
+		i[1] = first + 1;
+		i[2] = first + 2;
+		i[3] = first;
+		i[4] = first + 2;
+		i[5] = first + 3;
+	}
+
+	glGenBuffers(1, &quad_indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_indices);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(GLushort), indices, GL_STATIC_DRAW);
+	check_opengl_oom();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	free(indices);
+}
+
+static void buffer_unref_quad_indices(void)
+{
+	assert(quad_indices_users > 0);
+
+	if (--quad_indices_users > 0)
+		return;
+
+	glDeleteBuffers(1, &quad_indices);
+	quad_indices = 0;
+}
+
+static void buffer_stream_upload(Buffer *b, size_t used)
+{
+	assert(b);
+	assert(used <= BUFFER_STREAM_SIZE);
+
+	glBindBuffer(GL_ARRAY_BUFFER, b->vbo);
+	if (b->stream_offset + used > BUFFER_STREAM_SIZE) {
+		// the ring wrapped: orphan the storage so we don't wait for pending draws
+		glBufferData(GL_ARRAY_BUFFER, BUFFER_STREAM_SIZE * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+		check_opengl_oom();
+		b->stream_offset = 0;
+		render_stats.orphans += 1;
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, b->stream_offset * sizeof(Vertex), used * sizeof(Vertex), b->vertices);
+
+	b->draw_offset = b->stream_offset;
+	b->stream_offset += used;
+}
+
 static void buffer_upload(Buffer *b, int method)
 {
 	size_t used;
@@ -36,19 +99,15 @@ static void buffer_upload(Buffer *b, int method)
 		return;
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, b->buffers[0]);
-	glBufferData(GL_ARRAY_BUFFER, used * 2 * sizeof(GLfloat), b->positions, method);
-	check_opengl_oom();
-
-	glBindBuffer(GL_ARRAY_BUFFER, b->buffers[1]);
-	glBufferData(GL_ARRAY_BUFFER, used * 4 * sizeof(GLubyte), b->colors, method);
-	check_opengl_oom();
-
-	if (b->has_texture) {
-		glBindBuffer(GL_ARRAY_BUFFER, b->buffers[2]);
-		glBufferData(GL_ARRAY_BUFFER, used * 2 * sizeof(GLfloat), b->tex_coords, method);
+	if (b->streaming) {
+		buffer_stream_upload(b, used);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, b->vbo);
+		glBufferData(GL_ARRAY_BUFFER, used * sizeof(Vertex), b->vertices, method);
 		check_opengl_oom();
 	}
+
+	render_stats.uploaded_bytes += used * sizeof(Vertex);
 	b->uploaded = true;
 }
 
@@ -57,32 +116,22 @@ static void buffer_partial_free(Buffer *b)
 	if (!b)
 		return;
 
-	free(b->positions);
-	free(b->colors);
-	free(b->tex_coords);
-	b->positions = NULL;
-	b->colors = NULL;
-	b->tex_coords = NULL;
+	free(b->vertices);
+	b->vertices = NULL;
 }
 
 static bool buffer_is_full(const Buffer *b)
 {
 	assert(b);
 
-	return b->current_position > b->size - 3;
+	return b->current_position + BUFFER_VERTICES_PER_QUAD > b->size;
 }
 
 static void buffer_resize(Buffer *b) {
-	size_t size_positions = b->size * 2;
-	size_t size_colors = b->size * 4;
-	size_t size_tex_coords = b->size * 2;
-
-	XREALLOC(b->positions, size_positions, size_positions + 2);
-	XREALLOC(b->colors, size_colors, size_colors + 4);
-	if (b->tex_coords) {
-		XREALLOC(b->tex_coords, size_tex_coords, size_tex_coords + 2);
-	}
-	b->size = size_colors / 4;
+	size_t size = b->size;
+
+	XREALLOC(b->vertices, size, size + BUFFER_VERTICES_PER_QUAD);
+	b->size = size;
 	log_info("new size: %u", b->size);
 }
 
@@ -90,9 +139,10 @@ Buffer *buffer_new(bool user_buffer, unsigned int size)
 {
 	Buffer *b = new0(Buffer, 1);
 	b->size = size;
-	b->positions = new(GLfloat, size * 2);
-	b->colors = new(GLubyte, size * 4);
+	b->vertices = new(Vertex, size);
 	b->user_buffer = user_buffer;
+	// the default buffer is refilled at each flush, so stream it
+	b->streaming = !user_buffer;
 
 	return b;
 }
@@ -101,11 +151,36 @@ void buffer_allocate(Buffer *b)
 {
 	assert(b);
 
-	glGenBuffers(3, b->buffers);
+	if (b->streaming) {
+		assert(b->size <= BUFFER_STREAM_SIZE);
+
+		glGenBuffers(BUFFER_STREAM_FRAMES, b->stream_vbos);
+		for (unsigned int i = 0; i < BUFFER_STREAM_FRAMES; i++) {
+			glBindBuffer(GL_ARRAY_BUFFER, b->stream_vbos[i]);
+			glBufferData(GL_ARRAY_BUFFER, BUFFER_STREAM_SIZE * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+			check_opengl_oom();
+		}
+		b->vbo = b->stream_vbos[0];
+	} else {
+		glGenBuffers(1, &b->vbo);
+	}
+	buffer_ref_quad_indices();
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glEnableVertexAttribArray(ATTR_LOCATION_POSITION);
 	glEnableVertexAttribArray(ATTR_LOCATION_COLOR);
+	glEnableVertexAttribArray(ATTR_LOCATION_BLEND);
+}
+
+static void buffer_bind_textures(const Buffer *b)
+{
+	for (unsigned int i = 0; i < b->textures_count; i++) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		surface_draw_from(b->textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	// restore the current texture
+	glBindTexture(GL_TEXTURE_2D, b->draw_from ? b->draw_from->tex : 0);
 }
 
 void buffer_free(Buffer *b)
@@ -113,7 +188,13 @@ void buffer_free(Buffer *b)
 	if (!b)
 		return;
 
-	glDeleteBuffers(3, b->buffers);
+	if (b->streaming) {
+		glDeleteBuffers(BUFFER_STREAM_FRAMES, b->stream_vbos);
+	} else {
+		glDeleteBuffers(1, &b->vbo);
+	}
+	if (b->vbo)
+		buffer_unref_quad_indices();
 	buffer_partial_free(b);
 	free(b);
 }
@@ -126,16 +207,39 @@ void buffer_check_not_full(Buffer *b)
 		if (b->user_buffer) {
 			buffer_resize(b);
 		} else {
-			buffer_flush(b);
+			buffer_check_empty(b, FLUSH_FULL);
 		}
 	}
 }
 
-void buffer_check_empty(Buffer *b)
+/*
+ * Makes room for up to quads quads and returns how many can be pushed
+ * before the next check. User buffers are resized to fit them all.
+ */
+unsigned int buffer_check_room(Buffer *b, unsigned int quads)
+{
+	unsigned int room;
+
+	assert(b);
+
+	if (b->user_buffer) {
+		size_t size = b->size;
+		XREALLOC(b->vertices, size, b->current_position + quads * BUFFER_VERTICES_PER_QUAD);
+		b->size = size;
+	} else if (buffer_is_full(b)) {
+		buffer_check_empty(b, FLUSH_FULL);
+	}
+
+	room = (b->size - b->current_position) / BUFFER_VERTICES_PER_QUAD;
+	return quads < room ? quads : room;
+}
+
+void buffer_check_empty(Buffer *b, FlushReason reason)
 {
 	assert(b);
 
 	if (b->current_color != 0) {
+		render_stats.flushes[reason] += 1;
 		buffer_flush(b);
 	}
 }
@@ -145,12 +249,9 @@ void buffer_check_use_texture(Buffer *b)
 	assert(b);
 
 	if (!b->has_texture) {
-		buffer_flush(b);
+		buffer_check_empty(b, FLUSH_TEXTURE_MODE);
 		b->has_texture = true;
 	}
-	if (b->tex_coords == NULL) {
-		b->tex_coords = new(GLfloat, b->size * 2);
-	}
 }
 
 void buffer_check_not_use_texture(Buffer *b)
@@ -158,58 +259,142 @@ void buffer_check_not_use_texture(Buffer *b)
 	assert(b);
 
 	if (b->has_texture) {
-		buffer_flush(b);
+		buffer_check_empty(b, FLUSH_TEXTURE_MODE);
 		b->has_texture = false;
 	}
 }
 
+/*
+ * Same transformation as the default vertex shader, with the camera
+ * uniforms set by buffer_draw(). The result is a position that the
+ * shader maps to the same place with an identity camera.
+ */
+static void buffer_apply_camera(const Buffer *b, GLfloat *x, GLfloat *y)
+{
+	const Camera *c = b->camera;
+	const float *m = c->matrix;
+	float w = b->draw_on->texw;
+	float h = b->draw_on->texh;
+
+	float px = 2.f * (*x - c->dx) / w - 1.f;
+	float py = 2.f * (*y - c->dy) / h - 1.f;
+	float tx = c->zoom * (m[0] * px + m[2] * py);
+	float ty = c->zoom * (m[1] * px + m[3] * py);
+	*x = (tx + 1.f) * w / 2.f;
+	*y = (ty + 1.f) * h / 2.f;
+}
+
+void buffer_check_texture(Buffer *b, Surface *s)
+{
+	unsigned int i;
+
+	assert(b);
+
+	if (!buffer_batches_textures(b))
+		return;
+
+	assert(s);
+
+	for (i = 0; i < b->textures_count; i++) {
+		if (b->textures[i] == s) {
+			b->texture = i;
+			return;
+		}
+	}
+
+	if (b->textures_count == SHADER_MAX_TEXTURES)
+		buffer_check_empty(b, FLUSH_DRAW_FROM);
+
+	b->texture = b->textures_count;
+	b->textures[b->textures_count++] = s;
+}
+
+bool buffer_uses_texture(const Buffer *b, const Surface *s)
+{
+	assert(b);
+
+	for (unsigned int i = 0; i < b->textures_count; i++) {
+		if (b->textures[i] == s)
+			return true;
+	}
+	return false;
+}
+
 void buffer_push_vertex(Buffer *b, GLfloat x, GLfloat y)
 {
-	size_t cur;
+	Vertex *v;
 
 	assert(b);
 	assert(b->current_position < b->size);
 
-	cur = b->current_position * 2;
+	if (b->cpu_camera)
+		buffer_apply_camera(b, &x, &y);
 
-	b->positions[cur + 0] = x;
-	b->positions[cur + 1] = y;
+	v = &b->vertices[b->current_position];
+	v->x = x;
+	v->y = y;
 	b->current_position += 1;
 	b->uploaded = false;
 }
 
 void buffer_push_color(Buffer *buffer, GLubyte r, GLubyte g, GLubyte b, GLubyte a)
 {
-	size_t cur;
+	Vertex *v;
 
 	assert(buffer);
 	assert(buffer->current_color < buffer->size);
 
-	cur = buffer->current_color * 4;
-
-	buffer->colors[cur + 0] = r;
-	buffer->colors[cur + 1] = g;
-	buffer->colors[cur + 2] = b;
-	buffer->colors[cur + 3] = a;
+	v = &buffer->vertices[buffer->current_color];
+	v->r = r;
+	v->g = g;
+	v->b = b;
+	v->a = a;
+	v->blend = buffer->blend;
 	buffer->current_color += 1;
 	buffer->uploaded = false;
 }
 
 void buffer_push_tex_coord(Buffer *b, GLfloat x, GLfloat y)
 {
-	size_t cur;
+	Vertex *v;
 
 	assert(b);
 	assert(b->current_tex_coord < b->size);
 
-	cur = b->current_tex_coord * 2;
-
-	b->tex_coords[cur + 0] = x;
-	b->tex_coords[cur + 1] = y;
+	v = &b->vertices[b->current_tex_coord];
+	if (buffer_batches_textures(b)) {
+		// the textures have different sizes, normalize now
+		const Surface *s = b->textures[b->texture];
+		x /= s->texw;
+		y /= s->texh;
+		v->texture = b->texture;
+	}
+	v->u = x;
+	v->v = y;
 	b->current_tex_coord += 1;
 	b->uploaded = false;
 }
 
+void buffer_commit_quads(Buffer *b, unsigned int quads)
+{
+	unsigned int count = quads * BUFFER_VERTICES_PER_QUAD;
+
+	assert(b);
+	assert(b->current_color == b->current_position);
+	assert(b->current_position + count <= b->size);
+
+	if (b->cpu_camera) {
+		for (unsigned int i = b->current_position; i < b->current_position + count; i++)
+			buffer_apply_camera(b, &b->vertices[i].x, &b->vertices[i].y);
+	}
+
+	b->current_position += count;
+	b->current_color += count;
+	if (b->has_texture)
+		b->current_tex_coord += count;
+	b->uploaded = false;
+}
+
 void buffer_upload_and_free(Buffer *b)
 {
 	assert(b);
@@ -218,6 +403,19 @@ void buffer_upload_and_free(Buffer *b)
 	buffer_partial_free(b);
 }
 
+void buffer_next_frame(Buffer *b)
+{
+	assert(b);
+
+	if (!b->streaming)
+		return;
+
+	// this VBO was last used BUFFER_STREAM_FRAMES frames ago, the GPU should be done with it
+	b->stream_frame = (b->stream_frame + 1) % BUFFER_STREAM_FRAMES;
+	b->vbo = b->stream_vbos[b->stream_frame];
+	b->stream_offset = 0;
+}
+
 void buffer_draw(Buffer *b, float dx, float dy)
 {
 	size_t used;
@@ -229,10 +427,13 @@ void buffer_draw(Buffer *b, float dx, float dy)
 		return;
 	}
 
+	PROFILER_BEGIN(flush);
+
 	Shader* shader = b->shader;
 
 	assert(b->current_color == b->current_position);
 	assert(!b->has_texture || b->current_color == b->current_tex_coord);
+	assert(used % BUFFER_VERTICES_PER_QUAD == 0);
 	assert(shader);
 	assert(b->camera);
 
@@ -250,32 +451,77 @@ void buffer_draw(Buffer *b, float dx, float dy)
 	if (!b->uploaded)
 		buffer_upload(b, GL_DYNAMIC_DRAW);
 
-	glBindBuffer(GL_ARRAY_BUFFER, b->buffers[0]);
-	glVertexAttribPointer(ATTR_LOCATION_POSITION, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glBindBuffer(GL_ARRAY_BUFFER, b->buffers[1]);
-	glVertexAttribPointer(ATTR_LOCATION_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, NULL);
-
-	if (b->has_texture) {
-		glBindBuffer(GL_ARRAY_BUFFER, b->buffers[2]);
-		glEnableVertexAttribArray(ATTR_LOCATION_TEXCOORD);
-		glVertexAttribPointer(ATTR_LOCATION_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+	if (b->cpu_camera) {
+		// vertices are already transformed
+		static const GLfloat identity[4] = {1, 0, 0, 1};
+		glUniform1f(shader->vars[locationIndex].zoomLocation, 1);
+		glUniformMatrix2fv(shader->vars[locationIndex].rotationMatrixLocation, 1, GL_FALSE, identity);
+	} else {
+		dx -= b->camera->dx;
+		dy -= b->camera->dy;
+		glUniform1f(shader->vars[locationIndex].zoomLocation, b->camera->zoom);
+		glUniformMatrix2fv(shader->vars[locationIndex].rotationMatrixLocation, 1, GL_FALSE, b->camera->matrix);
 	}
-
-	dx -= b->camera->dx;
-	dy -= b->camera->dy;
 	glUniform1f(shader->vars[locationIndex].dxLocation, dx);
 	glUniform1f(shader->vars[locationIndex].dyLocation, dy);
-	glUniform1f(shader->vars[locationIndex].zoomLocation, b->camera->zoom);
-	glUniformMatrix2fv(shader->vars[locationIndex].rotationMatrixLocation, 1, GL_FALSE, b->camera->matrix);
 	glUniform2f(shader->vars[locationIndex].destinationSizeLocation, b->draw_on->texw, b->draw_on->texh);
-	if (b->draw_from)
+
+	bool batches_textures = b->has_texture && buffer_batches_textures(b);
+	if (batches_textures) {
+		// tex coords are already normalized
+		glUniform2f(shader->vars[locationIndex].sourceSizeLocation, 1, 1);
+		buffer_bind_textures(b);
+	} else if (b->draw_from) {
+		if (b->has_texture)
+			surface_draw_from(b->draw_from);
 		glUniform2f(shader->vars[locationIndex].sourceSizeLocation, b->draw_from->texw, b->draw_from->texh);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, b->vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_indices);
+	if (b->has_texture) {
+		glEnableVertexAttribArray(ATTR_LOCATION_TEXCOORD);
+	}
+	if (batches_textures) {
+		glEnableVertexAttribArray(ATTR_LOCATION_TEXINDEX);
+	}
 
-	glDrawArrays(GL_TRIANGLES, 0, used);
+	// the indices can only address BUFFER_MAX_QUADS_PER_DRAW quads, big user buffers need several draw calls
+	for (size_t first = 0; first < used; first += BUFFER_MAX_QUADS_PER_DRAW * BUFFER_VERTICES_PER_QUAD) {
+		size_t base = (b->draw_offset + first) * sizeof(Vertex);
+		size_t quads = (used - first) / BUFFER_VERTICES_PER_QUAD;
+		if (quads > BUFFER_MAX_QUADS_PER_DRAW)
+			quads = BUFFER_MAX_QUADS_PER_DRAW;
+
+		glVertexAttribPointer(ATTR_LOCATION_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+		                      (const GLvoid *) (base + offsetof(Vertex, x)));
+		glVertexAttribPointer(ATTR_LOCATION_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+		                      (const GLvoid *) (base + offsetof(Vertex, r)));
+		glVertexAttribPointer(ATTR_LOCATION_BLEND, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex),
+		                      (const GLvoid *) (base + offsetof(Vertex, blend)));
+		if (b->has_texture) {
+			glVertexAttribPointer(ATTR_LOCATION_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+			                      (const GLvoid *) (base + offsetof(Vertex, u)));
+		}
+		if (batches_textures) {
+			glVertexAttribPointer(ATTR_LOCATION_TEXINDEX, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex),
+			                      (const GLvoid *) (base + offsetof(Vertex, texture)));
+		}
+
+		glDrawElements(GL_TRIANGLES, quads * BUFFER_INDICES_PER_QUAD, GL_UNSIGNED_SHORT, NULL);
+		render_stats.draw_calls += 1;
+	}
+	render_stats.vertices += used;
 
 	if (b->has_texture) {
 		glDisableVertexAttribArray(ATTR_LOCATION_TEXCOORD);
 	}
+	if (batches_textures) {
+		glDisableVertexAttribArray(ATTR_LOCATION_TEXINDEX);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	PROFILER_END(flush, "flush");
 }
 
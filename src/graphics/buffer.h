@@ -27,20 +27,40 @@
 #endif
 
 typedef struct Buffer Buffer;
+typedef struct Vertex Vertex;
 
 #include "shader.h"
 #include "camera.h"
 #include "surface.h"
-
-// should be multiple of 3 (GL_TRIANGLES)
-#define BUFFER_DEFAULT_SIZE 3 * 4096
+#include "stats.h"
+
+// should be multiple of 4 (quads)
+#define BUFFER_DEFAULT_SIZE 4 * 4096
+
+// buffers contain quads, drawn with a shared index buffer
+// GL_UNSIGNED_SHORT indices can address 65536 vertices per draw call
+#define BUFFER_VERTICES_PER_QUAD 4
+#define BUFFER_INDICES_PER_QUAD 6
+#define BUFFER_MAX_QUADS_PER_DRAW (65536 / BUFFER_VERTICES_PER_QUAD)
+
+// streaming buffers cycle through one VBO per frame in flight,
+// each VBO being a ring of BUFFER_STREAM_SIZE vertices
+#define BUFFER_STREAM_FRAMES 3
+#define BUFFER_STREAM_SIZE (4 * BUFFER_DEFAULT_SIZE)
+
+// interleaved layout, uploaded as a whole in a single VBO
+struct Vertex {
+	GLfloat x, y;
+	GLubyte r, g, b, a;
+	GLfloat u, v; // only used if has_texture
+	GLubyte blend; // only used with premultiplied alpha
+	GLubyte texture; // only used with texture batching
+};
 
 struct Buffer {
 	unsigned int size;
-	GLuint buffers[3]; // first is for positions, second for colors, third (optional) for texcoords
-	GLfloat* positions;
-	GLubyte* colors;
-	GLfloat* tex_coords; // only if has_texture
+	GLuint vbo;
+	Vertex* vertices;
 	unsigned int current_position;
 	unsigned int current_color;
 	unsigned int current_tex_coord;
@@ -49,11 +69,26 @@ struct Buffer {
 	bool has_texture;
 	Shader* shader;
 	Camera* camera;
+	bool cpu_camera; // the camera is applied when vertices are pushed, not when the buffer is drawn
+	GLubyte blend; // blend of the next pushed colors
+
+	// surfaces sampled by the vertices, if the shader batches textures
+	Surface* textures[SHADER_MAX_TEXTURES];
+	unsigned int textures_count;
+	GLubyte texture; // index of the texture of the next pushed tex coords
 	bool user_buffer;
 
+	bool streaming;
+	GLuint stream_vbos[BUFFER_STREAM_FRAMES];
+	unsigned int stream_frame;
+	unsigned int stream_offset; // next free vertex in the current VBO
+	unsigned int draw_offset; // first vertex of the last upload
+
 	int ref;
+	size_t registry_index; // see object_registry.h
 	const Surface* draw_on;
-	const Surface* draw_from;
+	// source of the queued vertices, bound when they are drawn
+	Surface* draw_from;
 };
 
 Buffer *buffer_new(bool user_buffer, unsigned int size);
@@ -63,19 +98,24 @@ void buffer_allocate(Buffer *b);
 void buffer_push_vertex(Buffer *b, GLfloat, GLfloat);
 void buffer_push_color(Buffer *b, GLubyte, GLubyte, GLubyte, GLubyte);
 void buffer_push_tex_coord(Buffer *b, GLfloat, GLfloat);
+void buffer_commit_quads(Buffer *b, unsigned int quads);
 
 void buffer_draw(Buffer *b, float dx, float dy);
 
-void buffer_check_empty(Buffer *b);
+void buffer_check_empty(Buffer *b, FlushReason reason);
 void buffer_check_use_texture(Buffer *b);
 void buffer_check_not_use_texture(Buffer *b);
 void buffer_check_not_full(Buffer *b);
+unsigned int buffer_check_room(Buffer *b, unsigned int quads);
+void buffer_check_texture(Buffer *b, Surface *s);
+bool buffer_uses_texture(const Buffer *b, const Surface *s);
 
 void buffer_upload_and_free(Buffer *b);
+void buffer_next_frame(Buffer *b);
 
 static inline bool buffer_was_freed(const Buffer *b)
 {
-	return b->positions == NULL;
+	return b->vertices == NULL;
 }
 
 static inline void buffer_reset(Buffer *b)
@@ -83,6 +123,7 @@ static inline void buffer_reset(Buffer *b)
 	assert(b);
 
 	b->current_position = b->current_color = b->current_tex_coord = 0;
+	b->textures_count = 0;
 }
 
 static inline bool buffer_is_empty(Buffer *b)
@@ -92,6 +133,26 @@ static inline bool buffer_is_empty(Buffer *b)
 	return !b->current_position;
 }
 
+/*
+ * Vertices returned by buffer_check_room() can be written directly, then
+ * accounted with buffer_commit_quads(). Every field must be filled,
+ * including blend and, if the buffer batches textures, texture.
+ */
+static inline Vertex *buffer_reserved_vertices(Buffer *b)
+{
+	assert(b);
+
+	return &b->vertices[b->current_position];
+}
+
+static inline bool buffer_batches_textures(const Buffer *b)
+{
+	assert(b);
+
+	// user buffers can be drawn after their textures are freed
+	return !b->user_buffer && b->shader && b->shader->texturesLocation >= 0;
+}
+
 static inline void buffer_flush(Buffer *b)
 {
 	assert(b);
@@ -116,3 +177,12 @@ static inline void buffer_use_camera(Buffer *b, Camera *c)
 	b->camera = c;
 }
 
+static inline void buffer_use_cpu_camera(Buffer *b, bool cpu_camera)
+{
+	assert(b);
+	assert(!b->user_buffer);
+	assert(buffer_is_empty(b));
+
+	b->cpu_camera = cpu_camera;
+}
+
@@ -24,7 +24,7 @@
 
 log_category("buffer");
 
-IMPLEMENT_PUSHPOP(Buffer, buffer)
+IMPLEMENT_PUSHPOP(Buffer, buffer, OBJECT_BUFFER)
 
 int mlua_new_buffer(lua_State* L)
 {
@@ -99,6 +99,7 @@ int mlua_free_buffer(lua_State* L)
 	assert(L);
 
 	Buffer* buffer = pop_buffer(L, 1);
+	object_registry_remove(OBJECT_BUFFER, &buffer->registry_index);
 	display_free_buffer(buffer);
 	return 0;
 }
@@ -41,6 +41,9 @@ int mlua_camera__newindex(lua_State* L)
 	} else if (streq(name, "zoom")) {
 		lua_Number zoom = luaL_checknumber(L, 3);
 		display_set_camera_zoom(zoom);
+	} else if (streq(name, "batched")) {
+		bool batched = lua_toboolean(L, 3);
+		display_set_camera_batched(batched);
 	} else {
 		lua_rawset(L, 1);
 	}
@@ -69,6 +72,9 @@ int mlua_camera__index(lua_State* L)
 		lua_Number zoom = display_get_camera()->zoom;
 		lua_pushnumber(L, zoom);
 		return 1;
+	} else if (streq(name, "batched")) {
+		lua_pushboolean(L, display_is_camera_batched());
+		return 1;
 	}
 	return 0;
 }
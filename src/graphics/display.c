@@ -27,6 +27,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <math.h>
+#include <string.h>
 
 #include "display.h"
 #include "log.h"
@@ -36,16 +37,21 @@
 #include "buffer.h"
 #include "util.h"
 #include "opengl_util.h"
+#include "stats.h"
+#include "headless.h"
 
 log_category("display");
 
+#define DEFAULT_SHADER_VARIANTS 4
+
 static struct Display {
 	Buffer *default_buffer;
 	SDL_Window *sdl_window;
 	SDL_GLContext *gl_context;
 	Surface *screen;
 
-	Shader *default_shader;
+	// one variant per combination of premultiplied alpha and texture batching
+	Shader *default_shaders[DEFAULT_SHADER_VARIANTS];
 	Shader *current_shader;
 
 	Surface *current_on;
@@ -58,12 +64,19 @@ static struct Display {
 	unsigned char b;
 	unsigned char alpha;
 
+	BlendMode blend_mode;
+	bool premultiplied;
+	bool batch_textures;
+
 	Camera *camera;
 
 	int original_width;
 	int original_height;
 
 	bool debug_mode;
+	VsyncMode vsync;
+	// no window, the screen surface is never presented
+	bool headless;
 } display;
 
 static Shader *display_create_default_shader()
@@ -71,6 +84,14 @@ static Shader *display_create_default_shader()
 	const char* strvert = DEFAULT_VERTEX_SHADER;
 	const char* strfragcolor = DEFAULT_FRAGMENT_SHADER_COLOR;
 	const char* strfragtex = DEFAULT_FRAGMENT_SHADER_TEX;
+	if (display.premultiplied) {
+		strfragcolor = PREMULTIPLIED_FRAGMENT_SHADER_COLOR;
+		strfragtex = PREMULTIPLIED_FRAGMENT_SHADER_TEX;
+	}
+	if (display.batch_textures) {
+		strfragtex = display.premultiplied ? PREMULTIPLIED_MULTITEXTURE_FRAGMENT_SHADER_TEX
+		                                   : MULTITEXTURE_FRAGMENT_SHADER_TEX;
+	}
 	char* error;
 	Shader* shader = display_new_shader(strvert, strfragcolor, strfragtex, &error);
 	if (!shader) {
@@ -85,31 +106,39 @@ static int display_create_window(int w, int h)
 	assert(w > 0);
 	assert(h > 0);
 
+#ifdef BUILD_HEADLESS
+	if (display.headless) {
+		if (headless_init() < 0) {
+			return -1;
+		}
+	} else
+#endif
+	{
 #ifndef EMSCRIPTEN
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
-	display.sdl_window = SDL_CreateWindow("Drystal",
-	                                      SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-	                                      w, h, SDL_WINDOW_OPENGL);
-	if (!display.sdl_window) {
-		return -1;
-	}
-	display.gl_context = SDL_GL_CreateContext(display.sdl_window);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+		display.sdl_window = SDL_CreateWindow("Drystal",
+		                                      SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		                                      w, h, SDL_WINDOW_OPENGL);
+		if (!display.sdl_window) {
+			return -1;
+		}
+		display.gl_context = SDL_GL_CreateContext(display.sdl_window);
 #else
-	display.original_width = w;
-	display.original_height = h;
-	SDL_SetVideoMode(w, h, 32, SDL_OPENGL);
+		display.original_width = w;
+		display.original_height = h;
+		SDL_SetVideoMode(w, h, 32, SDL_OPENGL);
 #endif
 
-	SDL_GL_SetSwapInterval(1);
-	SDL_GetWindowSize(display.sdl_window, &w, &h);
+		display_set_vsync(display.vsync);
+		SDL_GetWindowSize(display.sdl_window, &w, &h);
+	}
 
 	display.screen = display_new_surface(w, h, true);
 	display_draw_on(display.screen);
 
-	display.default_shader = display_create_default_shader();
-	if (!display.default_shader) {
+	if (!display_get_default_shader()) {
 		return -1;
 	}
 	display_use_default_shader();
@@ -124,7 +153,7 @@ static int display_create_window(int w, int h)
 }
 
 
-int display_init(void)
+int display_init(bool headless)
 {
 	int r;
 
@@ -133,7 +162,8 @@ int display_init(void)
 	display.sdl_window = NULL;
 	display.gl_context = NULL;
 	display.screen = NULL;
-	display.default_shader = NULL;
+	for (int i = 0; i < DEFAULT_SHADER_VARIANTS; i++)
+		display.default_shaders[i] = NULL;
 	display.current_shader = NULL;
 	display.current_on = NULL;
 	display.current_from = NULL;
@@ -142,14 +172,21 @@ int display_init(void)
 	display.g = 255;
 	display.b = 255;
 	display.alpha = 255;
+	display.blend_mode = BLEND_DEFAULT;
+	display.premultiplied = false;
+	display.batch_textures = false;
 	display.original_width = 0;
 	display.original_height = 0;
 	display.debug_mode = false;
-
-	r = SDL_InitSubSystem(SDL_INIT_VIDEO);
-	if (r < 0) {
-		log_error("Failed to initialize SDL video subsystem: %s", SDL_GetError());
-		return r;
+	display.vsync = VSYNC_ON;
+	display.headless = headless;
+
+	if (!headless) {
+		r = SDL_InitSubSystem(SDL_INIT_VIDEO);
+		if (r < 0) {
+			log_error("Failed to initialize SDL video subsystem: %s", SDL_GetError());
+			return r;
+		}
 	}
 	// create the window in the constructor
 	// so we have an opengl context ready for the user
@@ -166,8 +203,12 @@ int display_init(void)
 
 void display_free()
 {
-	display_free_shader(display.default_shader);
-	display.default_shader = NULL;
+	// no shader is in use, so display_free_shader does not fall back on a default one
+	display.current_shader = NULL;
+	for (int i = 0; i < DEFAULT_SHADER_VARIANTS; i++) {
+		display_free_shader(display.default_shaders[i]);
+		display.default_shaders[i] = NULL;
+	}
 
 	buffer_free(display.default_buffer);
 	display.default_buffer = NULL;
@@ -187,9 +228,61 @@ void display_free()
 	// freed by lua's gc
 	display.screen = NULL;
 
+#ifdef BUILD_HEADLESS
+	if (display.headless) {
+		headless_free();
+		return;
+	}
+#endif
 	SDL_QuitSubSystem(SDL_INIT_VIDEO);
 }
 
+bool display_is_headless(void)
+{
+	return display.headless;
+}
+
+int display_set_vsync(VsyncMode mode)
+{
+	display.vsync = mode;
+	if (display.headless)
+		return 0;
+
+	if (SDL_GL_SetSwapInterval(mode) < 0) {
+		if (mode != VSYNC_ADAPTIVE) {
+			log_warning("Cannot set the swap interval: %s", SDL_GetError());
+			return -ENOTSUP;
+		}
+		log_warning("Adaptive vsync is not supported, using vsync");
+		display.vsync = VSYNC_ON;
+		SDL_GL_SetSwapInterval(VSYNC_ON);
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+VsyncMode display_get_vsync(void)
+{
+	return display.vsync;
+}
+
+bool display_is_paced_by_vsync(void)
+{
+	return !display.headless && display.vsync != VSYNC_OFF;
+}
+
+unsigned long display_get_refresh_period(void)
+{
+#ifndef EMSCRIPTEN
+	SDL_DisplayMode mode;
+
+	if (!display.headless && display.sdl_window
+	    && !SDL_GetWindowDisplayMode(display.sdl_window, &mode) && mode.refresh_rate > 0)
+		return USEC_PER_SEC / mode.refresh_rate;
+#endif
+	return 0;
+}
+
 void display_get_color(int *red, int *green, int *blue)
 {
 	assert(red);
@@ -216,11 +309,17 @@ void display_set_title(const char *title)
 {
 	assert(title);
 
+	if (display.headless)
+		return;
+
 	SDL_SetWindowTitle(display.sdl_window, title);
 }
 
 void display_set_fullscreen(bool fullscreen)
 {
+	if (display.headless)
+		return;
+
 	if (fullscreen) {
 		int w, h;
 #ifdef EMSCRIPTEN
@@ -244,11 +343,22 @@ void display_resize(int w, int h)
 {
 	int currentw, currenth;
 
-	SDL_GetWindowSize(display.sdl_window, &currentw, &currenth);
+	if (display.headless) {
+		currentw = display.screen->w;
+		currenth = display.screen->h;
+	} else {
+		SDL_GetWindowSize(display.sdl_window, &currentw, &currenth);
+	}
 	if (w == currentw && h == currenth)
 		return;
 	display.original_width = w;
 	display.original_height = h;
+	if (display.headless) {
+		// freed by lua's gc
+		display.screen = display_new_surface(w, h, true);
+		display_draw_on(display.screen);
+		return;
+	}
 #ifdef EMSCRIPTEN
 	emscripten_set_canvas_size(w, h);
 #else
@@ -308,8 +418,11 @@ void display_show_cursor(bool b)
 
 void display_draw_background()
 {
-	buffer_check_empty(display.current_buffer);
-	glClearColor(display.r / 255.f, display.g / 255.f, display.b / 255.f, display.alpha / 255.f);
+	buffer_check_empty(display.current_buffer, FLUSH_BACKGROUND);
+	float alpha = display.alpha / 255.f;
+	float premultiply = display.premultiplied ? alpha : 1.f;
+	glClearColor(display.r / 255.f * premultiply, display.g / 255.f * premultiply,
+	             display.b / 255.f * premultiply, alpha);
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
@@ -317,6 +430,15 @@ void display_flip()
 {
 	GLDEBUG();
 
+	if (display.headless) {
+		// nothing to present, only finish the frame
+		buffer_check_empty(display.default_buffer, FLUSH_FLIP);
+		buffer_next_frame(display.default_buffer);
+		render_stats_next_frame();
+		GLDEBUG();
+		return;
+	}
+
 	// save context
 	Surface *oldfrom = display.current_from;
 	Buffer *oldbuffer = display.current_buffer;
@@ -338,12 +460,15 @@ void display_flip()
 	float h = display.screen->h;
 	display.debug_mode = false;
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	render_stats.fbo_switches += 1;
 	glClearColor(0., 0., 0., 1.);
 	glClear(GL_COLOR_BUFFER_BIT);
 	display_draw_quad(0, 0, w, 0, w, h, 0, h,
 	                  0, h, w, h, w, 0, 0, 0); // y reversed
-	buffer_check_empty(display.current_buffer);
+	buffer_check_empty(display.current_buffer, FLUSH_FLIP);
 	SDL_GL_SwapWindow(display.sdl_window);
+	buffer_next_frame(display.default_buffer);
+	render_stats_next_frame();
 
 	// restore context
 	surface_draw_on(display.current_on);
@@ -361,6 +486,17 @@ void display_flip()
 	GLDEBUG();
 }
 
+int display_save_surface(Surface *surface, const char *filename)
+{
+	assert(surface);
+	assert(filename);
+
+	if (surface == display.current_on)
+		buffer_check_empty(display.default_buffer, FLUSH_DRAW_ON);
+
+	return surface_save_png(surface, filename, display.current_on);
+}
+
 Surface *display_get_screen()
 {
 	return display.screen;
@@ -398,13 +534,14 @@ void display_set_alpha(int a)
 	display.alpha = a;
 }
 
-void display_set_blend_mode(BlendMode mode)
+static void display_apply_blend_mode(BlendMode mode)
 {
-	buffer_check_empty(display.current_buffer);
-
 	switch (mode) {
 		case BLEND_ALPHA:
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			if (display.premultiplied)
+				glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			else
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			glBlendEquation(GL_FUNC_ADD);
 			break;
 		case BLEND_MULT:
@@ -412,12 +549,70 @@ void display_set_blend_mode(BlendMode mode)
 			glBlendEquation(GL_FUNC_ADD);
 			break;
 		case BLEND_ADD:
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+			if (display.premultiplied)
+				glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			else
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE);
 			glBlendEquation(GL_FUNC_ADD);
 			break;
 	}
 }
 
+static bool display_blend_is_batchable(BlendMode mode)
+{
+	// with premultiplied alpha, additive vertices only differ by their alpha
+	return display.premultiplied && (mode == BLEND_ALPHA || mode == BLEND_ADD);
+}
+
+void display_set_blend_mode(BlendMode mode)
+{
+	if (display_blend_is_batchable(display.blend_mode) && display_blend_is_batchable(mode)) {
+		render_stats.batched_blend_changes += 1;
+	} else {
+		buffer_check_empty(display.current_buffer, FLUSH_BLEND);
+		display_apply_blend_mode(mode);
+	}
+
+	display.blend_mode = mode;
+	display.current_buffer->blend = display.premultiplied && mode == BLEND_ADD;
+}
+
+void display_set_premultiplied_alpha(bool premultiplied)
+{
+	if (display.premultiplied == premultiplied)
+		return;
+
+	buffer_check_empty(display.current_buffer, FLUSH_BLEND);
+	bool use_default_shader = display.current_shader == display_get_default_shader();
+	display.premultiplied = premultiplied;
+	if (use_default_shader)
+		display_use_default_shader();
+
+	display_apply_blend_mode(display.blend_mode);
+	display.current_buffer->blend = premultiplied && display.blend_mode == BLEND_ADD;
+}
+
+bool display_is_premultiplied_alpha(void)
+{
+	return display.premultiplied;
+}
+
+void display_set_texture_batching(bool batch_textures)
+{
+	if (display.batch_textures == batch_textures)
+		return;
+
+	bool use_default_shader = display.current_shader == display_get_default_shader();
+	display.batch_textures = batch_textures;
+	if (use_default_shader)
+		display_use_default_shader();
+}
+
+bool display_is_texture_batching(void)
+{
+	return display.batch_textures;
+}
+
 void display_set_filter(Surface* surface, FilterMode filter)
 {
 	assert(surface);
@@ -438,9 +633,27 @@ Camera *display_get_camera()
 	return display.camera;
 }
 
+static void display_camera_changed(void)
+{
+	// a buffer with a cpu camera has already transformed its vertices
+	if (!display.current_buffer->cpu_camera)
+		buffer_check_empty(display.current_buffer, FLUSH_CAMERA);
+}
+
+void display_set_camera_batched(bool batched)
+{
+	buffer_check_empty(display.default_buffer, FLUSH_CAMERA);
+	buffer_use_cpu_camera(display.default_buffer, batched);
+}
+
+bool display_is_camera_batched(void)
+{
+	return display.default_buffer->cpu_camera;
+}
+
 void display_reset_camera()
 {
-	buffer_check_empty(display.current_buffer);
+	display_camera_changed();
 
 	camera_reset(display.camera);
 	camera_update_matrix(display.camera, display.current_on->w, display.current_on->h);
@@ -448,14 +661,14 @@ void display_reset_camera()
 
 void display_push_camera()
 {
-	buffer_check_empty(display.current_buffer);
+	display_camera_changed();
 
 	camera_push(display.camera);
 }
 
 void display_pop_camera()
 {
-	buffer_check_empty(display.current_buffer);
+	display_camera_changed();
 
 	camera_pop(display.camera);
 	camera_update_matrix(display.camera, display.current_on->w, display.current_on->h);
@@ -463,7 +676,7 @@ void display_pop_camera()
 
 void display_set_camera_position(float dx, float dy)
 {
-	buffer_check_empty(display.current_buffer);
+	display_camera_changed();
 
 	display.camera->dx = dx;
 	display.camera->dy = dy;
@@ -473,7 +686,7 @@ void display_set_camera_position(float dx, float dy)
 
 void display_set_camera_angle(float angle)
 {
-	buffer_check_empty(display.current_buffer);
+	display_camera_changed();
 
 	display.camera->angle = angle;
 	camera_update_matrix(display.camera, display.current_on->w, display.current_on->h);
@@ -481,7 +694,7 @@ void display_set_camera_angle(float angle)
 
 void display_set_camera_zoom(float zoom)
 {
-	buffer_check_empty(display.current_buffer);
+	display_camera_changed();
 
 	display.camera->zoom = zoom;
 }
@@ -496,17 +709,22 @@ Surface *display_get_draw_from()
 	return display.current_from;
 }
 
+/*
+ * The source is only recorded, the buffer switches to it when a textured
+ * primitive is drawn (see display_check_draw_from()), so switching back and
+ * forth between two draws is free.
+ */
 void display_draw_from(Surface *surface)
 {
-	if (display.current_from != surface) {
-		buffer_check_empty(display.current_buffer);
-		display.current_from = surface;
-		if (surface) {
-			surface_draw_from(surface);
-		} else {
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-		display.current_buffer->draw_from = display.current_from;
+	display.current_from = surface;
+}
+
+static void display_check_draw_from(Buffer *b)
+{
+	if (b->draw_from != display.current_from) {
+		if (!buffer_batches_textures(b))
+			buffer_check_empty(b, FLUSH_DRAW_FROM);
+		b->draw_from = display.current_from;
 	}
 }
 
@@ -514,7 +732,7 @@ void display_draw_on(Surface *surface)
 {
 	assert(surface);
 	if (display.current_on != surface) {
-		buffer_check_empty(display.current_buffer);
+		buffer_check_empty(display.current_buffer, FLUSH_DRAW_ON);
 		display.current_on = surface;
 		surface_draw_on(surface);
 
@@ -531,12 +749,21 @@ void display_draw_on(Surface *surface)
  */
 Surface *display_create_surface(unsigned int w, unsigned int h, unsigned int texw, unsigned int texh, unsigned char* pixels)
 {
-	return surface_new(w, h, texw, texh, FORMAT_RGBA, pixels, display.current_from, display.current_on);
+	if (!pixels || !display.premultiplied)
+		return surface_new(w, h, texw, texh, FORMAT_RGBA, pixels, display.current_from, display.current_on);
+
+	// the pixels belong to the caller, premultiply a copy of them
+	unsigned char *premultiplied = new(unsigned char, w * h * 4);
+	memcpy(premultiplied, pixels, w * h * 4);
+	surface_premultiply_alpha(premultiplied, w, h, FORMAT_RGBA);
+	Surface *surface = surface_new(w, h, texw, texh, FORMAT_RGBA, premultiplied, display.current_from, display.current_on);
+	free(premultiplied);
+	return surface;
 }
 
 int display_load_surface(const char * filename, Surface **surface)
 {
-	return surface_load(filename, surface, display.current_from);
+	return surface_load(filename, surface, display.current_from, display.premultiplied);
 }
 
 Surface *display_new_surface(int w, int h, bool force_npot)
@@ -563,13 +790,20 @@ void display_free_surface(Surface* surface)
 	if (!surface)
 		return;
 
-	if (surface == display.current_from) {
+	if (buffer_uses_texture(display.default_buffer, surface)
+	    || display.default_buffer->draw_from == surface) {
+		buffer_check_empty(display.default_buffer, FLUSH_FREE_SURFACE);
+	}
+	if (display.current_buffer->draw_from == surface) {
 		buffer_check_not_use_texture(display.current_buffer);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		display.current_from = NULL;
+		display.current_buffer->draw_from = NULL;
 	}
+	if (display.default_buffer->draw_from == surface)
+		display.default_buffer->draw_from = NULL;
+	if (surface == display.current_from)
+		display.current_from = NULL;
 	if (surface == display.current_on) {
-		buffer_check_empty(display.current_buffer);
+		buffer_check_empty(display.current_buffer, FLUSH_FREE_SURFACE);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		display.current_on = NULL;
 	}
@@ -580,15 +814,85 @@ void display_free_surface(Surface* surface)
  * Primitive drawing
  */
 
+static void display_draw_quad_outline(float x1, float y1, float x2, float y2,
+                                      float x3, float y3, float x4, float y4)
+{
+	display.debug_mode = false;
+	display_draw_line(x1, y1, x2, y2, 1.f);
+	display_draw_line(x2, y2, x3, y3, 1.f);
+	display_draw_line(x3, y3, x1, y1, 1.f);
+	if (x4 != x3 || y4 != y3) { // not a degenerated triangle
+		display_draw_line(x3, y3, x4, y4, 1.f);
+		display_draw_line(x4, y4, x1, y1, 1.f);
+	}
+	display.debug_mode = true;
+}
+
+static void display_draw_color_quad(float x1, float y1, float x2, float y2,
+                                    float x3, float y3, float x4, float y4)
+{
+	Buffer *current_buffer = display.current_buffer;
+	unsigned char r = display.r;
+	unsigned char g = display.g;
+	unsigned char b = display.b;
+	unsigned char alpha = display.alpha;
+	int i;
+
+	if (display.debug_mode && !current_buffer->user_buffer) {
+		display_draw_quad_outline(x1, y1, x2, y2, x3, y3, x4, y4);
+		return;
+	}
+
+	buffer_check_not_use_texture(current_buffer);
+	buffer_check_not_full(current_buffer);
+
+	buffer_push_vertex(current_buffer, x1, y1);
+	buffer_push_vertex(current_buffer, x2, y2);
+	buffer_push_vertex(current_buffer, x3, y3);
+	buffer_push_vertex(current_buffer, x4, y4);
+	for (i = 0; i < 4; i++)
+		buffer_push_color(current_buffer, r, g, b, alpha);
+}
+
+void display_draw_triangles(const float *triangles, unsigned int count)
+{
+	Buffer *current_buffer = display.current_buffer;
+	unsigned char r = display.r;
+	unsigned char g = display.g;
+	unsigned char b = display.b;
+	unsigned char alpha = display.alpha;
+
+	assert(triangles || !count);
+
+	if (display.debug_mode && !current_buffer->user_buffer) {
+		for (unsigned int i = 0; i < count; i++, triangles += 6)
+			display_draw_triangle(triangles[0], triangles[1], triangles[2],
+			                      triangles[3], triangles[4], triangles[5]);
+		return;
+	}
+
+	buffer_check_not_use_texture(current_buffer);
+	while (count > 0) {
+		unsigned int n = buffer_check_room(current_buffer, count);
+		count -= n;
+		for (; n > 0; n--, triangles += 6) {
+			buffer_push_vertex(current_buffer, triangles[0], triangles[1]);
+			buffer_push_vertex(current_buffer, triangles[2], triangles[3]);
+			buffer_push_vertex(current_buffer, triangles[4], triangles[5]);
+			buffer_push_vertex(current_buffer, triangles[4], triangles[5]);
+			for (int i = 0; i < 4; i++)
+				buffer_push_color(current_buffer, r, g, b, alpha);
+		}
+	}
+}
+
 void display_draw_point(float x, float y, float size)
 {
 	float hs = size / 2;
-	display_draw_triangle(x - hs, y - hs,
-						  x + hs, y - hs,
-						  x + hs, y + hs);
-	display_draw_triangle(x - hs, y - hs,
-						  x + hs, y + hs,
-						  x - hs, y + hs);
+	display_draw_color_quad(x - hs, y - hs,
+	                        x + hs, y - hs,
+	                        x + hs, y + hs,
+	                        x - hs, y + hs);
 }
 
 void display_draw_point_tex(float sx, float sy, float x, float y, float size)
@@ -622,40 +926,24 @@ void display_draw_line(float x1, float y1, float x2, float y2, float width)
 	float yy2 = y1 + dy;
 	float yy3 = y2 + dy;
 	float yy4 = y2 - dy;
-	display_draw_triangle(xx1, yy1, xx2, yy2, xx3, yy3);
-	display_draw_triangle(xx1, yy1, xx3, yy3, xx4, yy4);
+	display_draw_color_quad(xx1, yy1, xx2, yy2, xx3, yy3, xx4, yy4);
 }
 
 void display_draw_triangle(float x1, float y1, float x2, float y2, float x3, float y3)
 {
-	Buffer *current_buffer = display.current_buffer;
-	unsigned char r = display.r;
-	unsigned char g = display.g;
-	unsigned char b = display.b;
-	unsigned char alpha = display.alpha;
-	int i;
-
-	if (display.debug_mode && !current_buffer->user_buffer) {
-		display.debug_mode = false;
-		display_draw_line(x1, y1, x2, y2, 1.f);
-		display_draw_line(x2, y2, x3, y3, 1.f);
-		display_draw_line(x3, y3, x1, y1, 1.f);
-		display.debug_mode = true;
-		return;
-	}
-
-	buffer_check_not_use_texture(current_buffer);
-	buffer_check_not_full(current_buffer);
-
-	buffer_push_vertex(current_buffer, x1, y1);
-	buffer_push_vertex(current_buffer, x2, y2);
-	buffer_push_vertex(current_buffer, x3, y3);
-	for (i = 0; i < 3; i++)
-		buffer_push_color(current_buffer, r, g, b, alpha);
+	// buffers only contain quads, the last vertex is repeated to make the second triangle degenerated
+	display_draw_color_quad(x1, y1, x2, y2, x3, y3, x3, y3);
 }
 
 void display_draw_surface(float xi1, float yi1, float xi2, float yi2, float xi3, float yi3,
                           float xo1, float yo1, float xo2, float yo2, float xo3, float yo3)
+{
+	display_draw_quad(xi1, yi1, xi2, yi2, xi3, yi3, xi3, yi3,
+	                  xo1, yo1, xo2, yo2, xo3, yo3, xo3, yo3);
+}
+
+void display_draw_quad(float xi1, float yi1, float xi2, float yi2, float xi3, float yi3, float xi4, float yi4,
+                       float xo1, float yo1, float xo2, float yo2, float xo3, float yo3, float xo4, float yo4)
 {
 	Buffer *current_buffer = display.current_buffer;
 	unsigned char r = display.r;
@@ -665,11 +953,7 @@ void display_draw_surface(float xi1, float yi1, float xi2, float yi2, float xi3,
 	int i;
 
 	if (display.debug_mode && !current_buffer->user_buffer) {
-		display.debug_mode = false;
-		display_draw_line(xo1, yo1, xo2, yo2, 1.f);
-		display_draw_line(xo2, yo2, xo3, yo3, 1.f);
-		display_draw_line(xo3, yo3, xo1, yo1, 1.f);
-		display.debug_mode = true;
+		display_draw_quad_outline(xo1, yo1, xo2, yo2, xo3, yo3, xo4, yo4);
 		return;
 	}
 
@@ -677,26 +961,58 @@ void display_draw_surface(float xi1, float yi1, float xi2, float yi2, float xi3,
 
 	buffer_check_use_texture(current_buffer);
 	buffer_check_not_full(current_buffer);
+	display_check_draw_from(current_buffer);
+	buffer_check_texture(current_buffer, display.current_from);
 
 	buffer_push_tex_coord(current_buffer, xi1, yi1);
 	buffer_push_tex_coord(current_buffer, xi2, yi2);
 	buffer_push_tex_coord(current_buffer, xi3, yi3);
+	buffer_push_tex_coord(current_buffer, xi4, yi4);
 
 	buffer_push_vertex(current_buffer, xo1, yo1);
 	buffer_push_vertex(current_buffer, xo2, yo2);
 	buffer_push_vertex(current_buffer, xo3, yo3);
+	buffer_push_vertex(current_buffer, xo4, yo4);
 
-	for (i = 0; i < 3; i++)
+	for (i = 0; i < 4; i++)
 		buffer_push_color(current_buffer, r, g, b, alpha);
 }
 
-void display_draw_quad(float xi1, float yi1, float xi2, float yi2, float xi3, float yi3, float xi4, float yi4,
-                       float xo1, float yo1, float xo2, float yo2, float xo3, float yo3, float xo4, float yo4)
+void display_draw_quads(const float *quads, unsigned int count)
 {
-	display_draw_surface(xi1, yi1, xi2, yi2, xi3, yi3, xo1, yo1, xo2, yo2, xo3, yo3);
-	display_draw_surface(xi1, yi1, xi3, yi3, xi4, yi4, xo1, yo1, xo3, yo3, xo4, yo4);
-}
+	Buffer *current_buffer = display.current_buffer;
+	unsigned char r = display.r;
+	unsigned char g = display.g;
+	unsigned char b = display.b;
+	unsigned char alpha = display.alpha;
+
+	assert(quads || !count);
 
+	if (display.debug_mode && !current_buffer->user_buffer) {
+		for (unsigned int i = 0; i < count; i++, quads += 16)
+			display_draw_quad_outline(quads[8], quads[9], quads[10], quads[11],
+			                          quads[12], quads[13], quads[14], quads[15]);
+		return;
+	}
+
+	assert(display.current_from);
+
+	buffer_check_use_texture(current_buffer);
+	display_check_draw_from(current_buffer);
+	while (count > 0) {
+		unsigned int n = buffer_check_room(current_buffer, count);
+		buffer_check_texture(current_buffer, display.current_from);
+		count -= n;
+		for (; n > 0; n--, quads += 16) {
+			for (int i = 0; i < 8; i += 2)
+				buffer_push_tex_coord(current_buffer, quads[i], quads[i + 1]);
+			for (int i = 8; i < 16; i += 2)
+				buffer_push_vertex(current_buffer, quads[i], quads[i + 1]);
+			for (int i = 0; i < 4; i++)
+				buffer_push_color(current_buffer, r, g, b, alpha);
+		}
+	}
+}
 
 /**
  * Shader
@@ -736,10 +1052,10 @@ Shader * display_new_shader(const char* strvert, const char* strfragcolor, const
 		strvert = DEFAULT_VERTEX_SHADER;
 	}
 	if (!strfragcolor || !*strfragcolor) {
-		strfragcolor = DEFAULT_FRAGMENT_SHADER_COLOR;
+		strfragcolor = display.premultiplied ? PREMULTIPLIED_FRAGMENT_SHADER_COLOR : DEFAULT_FRAGMENT_SHADER_COLOR;
 	}
 	if (!strfragtex || !*strfragtex) {
-		strfragtex = DEFAULT_FRAGMENT_SHADER_TEX;
+		strfragtex = display.premultiplied ? PREMULTIPLIED_FRAGMENT_SHADER_TEX : DEFAULT_FRAGMENT_SHADER_TEX;
 	}
 
 	assert(strfragtex);
@@ -779,6 +1095,8 @@ Shader * display_new_shader(const char* strvert, const char* strfragcolor, const
 	glBindAttribLocation(prog_color, ATTR_LOCATION_POSITION, "position");
 	glBindAttribLocation(prog_color, ATTR_LOCATION_COLOR, "color");
 	glBindAttribLocation(prog_color, ATTR_LOCATION_TEXCOORD, "texCoord");
+	glBindAttribLocation(prog_color, ATTR_LOCATION_BLEND, "blend");
+	glBindAttribLocation(prog_color, ATTR_LOCATION_TEXINDEX, "texIndex");
 	glAttachShader(prog_color, vert);
 	glAttachShader(prog_color, frag_color);
 	glLinkProgram(prog_color);
@@ -788,6 +1106,8 @@ Shader * display_new_shader(const char* strvert, const char* strfragcolor, const
 	glBindAttribLocation(prog_tex, ATTR_LOCATION_POSITION, "position");
 	glBindAttribLocation(prog_tex, ATTR_LOCATION_COLOR, "color");
 	glBindAttribLocation(prog_tex, ATTR_LOCATION_TEXCOORD, "texCoord");
+	glBindAttribLocation(prog_tex, ATTR_LOCATION_BLEND, "blend");
+	glBindAttribLocation(prog_tex, ATTR_LOCATION_TEXINDEX, "texIndex");
 	glAttachShader(prog_tex, vert);
 	glAttachShader(prog_tex, frag_tex);
 	glLinkProgram(prog_tex);
@@ -824,15 +1144,24 @@ void display_use_shader(Shader* shader)
 {
 	assert(shader);
 
-	buffer_check_empty(display.current_buffer);
+	buffer_check_empty(display.current_buffer, FLUSH_SHADER);
 
 	display.current_shader = shader;
 	buffer_use_shader(display.current_buffer, shader);
 }
 
+Shader *display_get_default_shader(void)
+{
+	Shader **shader = &display.default_shaders[display.premultiplied + 2 * display.batch_textures];
+
+	if (!*shader)
+		*shader = display_create_default_shader();
+	return *shader;
+}
+
 void display_use_default_shader()
 {
-	display_use_shader(display.default_shader);
+	display_use_shader(display_get_default_shader());
 }
 
 void display_free_shader(Shader *shader)
@@ -863,7 +1192,7 @@ void display_use_buffer(Buffer* buffer)
 	display.current_buffer = buffer;
 	buffer_use_shader(buffer, display.current_shader);
 	buffer->draw_on = display.current_on;
-	buffer->draw_from = display.current_from;
+	buffer->blend = display.premultiplied && display.blend_mode == BLEND_ADD;
 }
 
 void display_use_default_buffer()
@@ -875,7 +1204,7 @@ void display_draw_buffer(Buffer* buffer, float dx, float dy)
 {
 	assert(buffer);
 
-	buffer_check_empty(display.current_buffer);
+	buffer_check_empty(display.current_buffer, FLUSH_BUFFER);
 	buffer->draw_on = display.current_on;
 	buffer->draw_from = display.current_from;
 	buffer_draw(buffer, dx, dy);
@@ -41,7 +41,24 @@ enum BlendMode {
 };
 typedef enum BlendMode BlendMode;
 
-int display_init(void);
+// values of SDL_GL_SetSwapInterval
+enum VsyncMode {
+	VSYNC_ADAPTIVE = -1,
+	VSYNC_OFF = 0,
+	VSYNC_ON = 1,
+};
+typedef enum VsyncMode VsyncMode;
+
+// the headless mode draws without any window, see headless.h
+int display_init(bool headless);
+bool display_is_headless(void);
+// falls back to VSYNC_ON if adaptive vsync is not supported
+int display_set_vsync(VsyncMode mode);
+VsyncMode display_get_vsync(void);
+// whether display_flip waits for the vertical blank
+bool display_is_paced_by_vsync(void);
+// in microseconds, 0 when unknown
+unsigned long display_get_refresh_period(void);
 void display_free(void);
 
 void display_set_title(const char *title);
@@ -58,6 +75,10 @@ void display_get_color(int *red, int *green, int *blue);
 void display_get_alpha(int *a);
 
 void display_set_blend_mode(BlendMode mode);
+void display_set_premultiplied_alpha(bool premultiplied);
+bool display_is_premultiplied_alpha(void);
+void display_set_texture_batching(bool batch_textures);
+bool display_is_texture_batching(void);
 void display_set_filter(Surface* surface, FilterMode mode);
 void display_get_pixel(Surface* surface, unsigned int x, unsigned int y,
 		       int* red, int* green, int* blue, int* alpha);
@@ -69,8 +90,13 @@ void display_pop_camera(void);
 void display_set_camera_position(float dx, float dy);
 void display_set_camera_angle(float angle);
 void display_set_camera_zoom(float zoom);
+void display_set_camera_batched(bool batched);
+bool display_is_camera_batched(void);
 
 Surface* display_get_screen(void);
+// writes the surface to a PNG file, returns a negative errno on failure
+int display_save_surface(Surface *surface, const char *filename);
+// pixels are premultiplied in place when premultiplied alpha is enabled
 Surface* display_create_surface(unsigned int w, unsigned int h, unsigned int texw, unsigned int texh, unsigned char* pixels);
 Surface* display_new_surface(int w, int h, bool force_npot);
 int display_load_surface(const char *filename, Surface **surface);
@@ -86,12 +112,17 @@ void display_draw_point(float x, float y, float size);
 void display_draw_point_tex(float sx, float sy, float x, float y, float size);
 void display_draw_line(float x1, float y1, float x2, float y2, float width);
 void display_draw_triangle(float x1, float y1, float x2, float y2, float x3, float y3);
+// 6 floats per triangle: x1, y1, x2, y2, x3, y3
+void display_draw_triangles(const float *triangles, unsigned int count);
 void display_draw_surface(float, float, float, float, float, float, float, float, float, float, float, float);
 void display_draw_quad(float xi1, float yi1, float xi2, float yi2, float xi3, float yi3, float xi4, float yi4,
                        float xo1, float yo1, float xo2, float yo2, float xo3, float yo3, float xo4, float yo4);
+// 16 floats per quad, in the same order as display_draw_quad arguments
+void display_draw_quads(const float *quads, unsigned int count);
 
 Shader* display_new_shader(const char* strvert, const char* strfragcolor, const char* strfragtex, char** error);
 void display_use_shader(Shader *shader);
+Shader *display_get_default_shader(void);
 void display_use_default_shader(void);
 void display_free_shader(Shader *shader);
 
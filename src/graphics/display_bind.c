@@ -22,14 +22,18 @@
 #include "display.h"
 #include "buffer.h"
 #include "display_bind.h"
+#include "stats.h"
 #include "lua_util.h"
 #include "dlua.h"
 #include "log.h"
 #include "util.h"
+#ifdef BUILD_UTILS
+#include "utils/array_bind.h"
+#endif
 
 log_category("graphics");
 
-IMPLEMENT_PUSHPOP(Surface, surface)
+IMPLEMENT_PUSHPOP(Surface, surface, OBJECT_SURFACE)
 
 int mlua_set_color(lua_State* L)
 {
@@ -92,6 +96,24 @@ int mlua_set_title(lua_State* L)
 	return 0;
 }
 
+int mlua_set_premultiplied_alpha(lua_State* L)
+{
+	assert(L);
+
+	bool premultiplied = lua_toboolean(L, 1);
+	display_set_premultiplied_alpha(premultiplied);
+	return 0;
+}
+
+int mlua_set_texture_batching(lua_State* L)
+{
+	assert(L);
+
+	bool batch_textures = lua_toboolean(L, 1);
+	display_set_texture_batching(batch_textures);
+	return 0;
+}
+
 int mlua_set_blend_mode(lua_State* L)
 {
 	assert(L);
@@ -101,6 +123,18 @@ int mlua_set_blend_mode(lua_State* L)
 	return 0;
 }
 
+int mlua_set_vsync(lua_State* L)
+{
+	assert(L);
+
+	lua_Integer mode = luaL_checkinteger(L, 1);
+
+	assert_lua_error(L, mode >= VSYNC_ADAPTIVE && mode <= VSYNC_ON, "set_vsync: invalid mode");
+
+	display_set_vsync((VsyncMode) mode);
+	return 0;
+}
+
 int mlua_show_cursor(lua_State* L)
 {
 	assert(L);
@@ -141,6 +175,36 @@ int mlua_screen2scene(lua_State* L)
 	return 2;
 }
 
+int mlua_get_render_stats(lua_State* L)
+{
+	assert(L);
+
+	const RenderStats *stats = lua_toboolean(L, 1) ? &render_stats : &render_stats_last_frame;
+	lua_newtable(L);
+	lua_pushnumber(L, stats->draw_calls);
+	lua_setfield(L, -2, "draw_calls");
+	lua_pushnumber(L, stats->vertices);
+	lua_setfield(L, -2, "vertices");
+	lua_pushnumber(L, stats->uploaded_bytes);
+	lua_setfield(L, -2, "bytes_uploaded");
+	lua_pushnumber(L, stats->orphans);
+	lua_setfield(L, -2, "orphans");
+	lua_pushnumber(L, stats->texture_binds);
+	lua_setfield(L, -2, "texture_binds");
+	lua_pushnumber(L, stats->fbo_switches);
+	lua_setfield(L, -2, "fbo_switches");
+	lua_pushnumber(L, stats->batched_blend_changes);
+	lua_setfield(L, -2, "batched_blend_changes");
+
+	lua_newtable(L);
+	for (int i = 0; i < FLUSH_REASON_COUNT; i++) {
+		lua_pushnumber(L, stats->flushes[i]);
+		lua_setfield(L, -2, FLUSH_REASON_NAMES[i]);
+	}
+	lua_setfield(L, -2, "flushes");
+	return 1;
+}
+
 int mlua_surface_class_index(lua_State* L)
 {
 	assert(L);
@@ -204,6 +268,7 @@ int mlua_free_surface(lua_State* L)
 	assert(L);
 
 	Surface* surface = pop_surface(L, 1);
+	object_registry_remove(OBJECT_SURFACE, &surface->registry_index);
 	display_free_surface(surface);
 	return 0;
 }
@@ -353,6 +418,100 @@ int mlua_draw_triangle(lua_State* L)
 	return 0;
 }
 
+#define BULK_CHUNK_SIZE (16 * 6 * 16) // a multiple of the quad and triangle strides
+
+/*
+ * Reads the numbers of the array (argument 1) by chunks,
+ * and draws count (argument 2, optional) primitives of stride numbers.
+ * float32 arrays made with new_array are drawn without any copy.
+ * A table is checked before anything is drawn, so an error draws nothing.
+ */
+static int draw_bulk(lua_State* L, const char *name, unsigned int stride,
+                     void (*draw)(const float *, unsigned int))
+{
+	float values[BULK_CHUNK_SIZE];
+	lua_Integer per_chunk = BULK_CHUNK_SIZE / stride;
+	lua_Integer index = 1;
+	lua_Integer len;
+#ifdef BUILD_UTILS
+	Array *array = test_array(L, 1);
+
+	if (array)
+		len = array->length;
+	else
+#endif
+	{
+		luaL_checktype(L, 1, LUA_TTABLE);
+		len = luaL_len(L, 1);
+	}
+	lua_Integer count = luaL_optinteger(L, 2, len / stride);
+	if (count < 0 || count * (lua_Integer) stride > len)
+		return luaL_error(L, "%s: the array must contain %u numbers per primitive", name, stride);
+
+#ifdef BUILD_UTILS
+	if (array && array->type == ARRAY_FLOAT32) {
+		draw(array->data, count);
+		return 0;
+	}
+	if (!array)
+#endif
+	{
+		for (lua_Integer i = 1; i <= count * (lua_Integer) stride; i++) {
+			int isnum;
+			lua_rawgeti(L, 1, i);
+			lua_tonumberx(L, -1, &isnum);
+			lua_pop(L, 1);
+			if (!isnum)
+				return luaL_error(L, "%s: the array must only contain numbers", name);
+		}
+	}
+
+	while (count > 0) {
+		lua_Integer n = count < per_chunk ? count : per_chunk;
+#ifdef BUILD_UTILS
+		if (array) {
+			array_get_floats(array, index - 1, n * stride, values);
+			index += n * stride;
+			draw(values, n);
+			count -= n;
+			continue;
+		}
+#endif
+		for (lua_Integer i = 0; i < n * (lua_Integer) stride; i++) {
+			lua_rawgeti(L, 1, index++);
+			values[i] = lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+		draw(values, n);
+		count -= n;
+	}
+	return 0;
+}
+
+int mlua_draw_triangles(lua_State* L)
+{
+	assert(L);
+
+	Buffer* buffer = display_get_current_buffer();
+	assert_lua_error(L, !buffer->user_buffer || buffer_is_empty(buffer) || !buffer->has_texture,
+					 "draw_triangles: the current buffer cannot contain non textured triangles");
+
+	return draw_bulk(L, "draw_triangles", 6, display_draw_triangles);
+}
+
+int mlua_draw_quads(lua_State* L)
+{
+	assert(L);
+
+	assert_lua_error(L, display_get_draw_from(), "draw_quads: no 'drawn from' surface bound");
+
+	Buffer* buffer = display_get_current_buffer();
+	assert_lua_error(L, !buffer->user_buffer || buffer_is_empty(buffer) || buffer->has_texture,
+					 "draw_quads: the current buffer cannot contain textured triangles");
+
+	return draw_bulk(L, "draw_quads", 16, display_draw_quads);
+}
+
 int mlua_draw_surface(lua_State* L)
 {
 	assert(L);
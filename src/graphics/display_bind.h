@@ -27,11 +27,15 @@ int mlua_set_color(lua_State* L);
 int mlua_set_alpha(lua_State* L);
 int mlua_set_title(lua_State* L);
 int mlua_set_blend_mode(lua_State* L);
+int mlua_set_premultiplied_alpha(lua_State* L);
+int mlua_set_texture_batching(lua_State* L);
 
 int mlua_show_cursor(lua_State* L);
 int mlua_resize(lua_State* L);
 int mlua_set_fullscreen(lua_State* L);
+int mlua_set_vsync(lua_State* L);
 int mlua_screen2scene(lua_State* L);
+int mlua_get_render_stats(lua_State* L);
 
 int mlua_surface_class_index(lua_State* L);
 int mlua_load_surface(lua_State* L);
@@ -49,4 +53,6 @@ int mlua_draw_line(lua_State* L);
 int mlua_draw_triangle(lua_State* L);
 int mlua_draw_surface(lua_State* L);
 int mlua_draw_quad(lua_State* L);
+int mlua_draw_triangles(lua_State* L);
+int mlua_draw_quads(lua_State* L);
 
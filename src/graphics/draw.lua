@@ -14,11 +14,31 @@ function drystal.draw_image(x, y, w, h, dx, dy, dw, dh)
 				dx, dy, dx+dw, dy, dx+dw, dy+dh, dx, dy+dh)
 end
 
+-- atlas regions are drawn from their page, the previous surface is restored afterwards
+-- (changing the source is free until something is drawn, see display_draw_from)
+local function draw_from_region(sprite)
+	local page = sprite.surface
+	if page then
+		local old_from = drystal.current_draw_from
+		if old_from ~= page then
+			page:draw_from()
+			return old_from
+		end
+	end
+end
+
+local function restore_draw_from(old_from)
+	if old_from then
+		old_from:draw_from()
+	end
+end
+
 local notransform = {
 	angle=0, -- in radians
 	wfactor=1, hfactor=1 -- can be negative to flip
 }
 function drystal.draw_sprite_simple(sprite, x, y)
+	local old_from = draw_from_region(sprite)
 	local w = sprite.w
 	local h = sprite.h
 	local x1, y1 = x, y
@@ -31,6 +51,7 @@ function drystal.draw_sprite_simple(sprite, x, y)
 
 	_draw_quad(xi, yi, xi2, yi, xi2, yi2, xi, yi2,
 				  x1, y1, x2,  y1, x2,  y2,  x1, y2)
+	restore_draw_from(old_from)
 end
 function drystal.draw_sprite(sprite, x, y, transform, hx, hy)
 	if not transform then
@@ -38,6 +59,7 @@ function drystal.draw_sprite(sprite, x, y, transform, hx, hy)
 		return
 	end
 
+	local old_from = draw_from_region(sprite)
 	local w = sprite.w * math.abs(transform.wfactor)
 	local h = sprite.h * math.abs(transform.hfactor)
 	if not hx then hx = w / 2 end
@@ -73,6 +95,7 @@ function drystal.draw_sprite(sprite, x, y, transform, hx, hy)
 
 	_draw_quad(xi, yi, xi2, yi, xi2, yi2, xi, yi2,
 				  x1, y1, x2,  y2, x3,  y3,  x4, y4)
+	restore_draw_from(old_from)
 end
 function drystal.draw_sprite_rotated(sprite, x, y, angle, hx, hy)
 	local transform = {
@@ -82,7 +105,9 @@ function drystal.draw_sprite_rotated(sprite, x, y, angle, hx, hy)
 	drystal.draw_sprite(sprite, x, y, transform, hx, hy)
 end
 function drystal.draw_sprite_resized(sprite, x, y, w, h)
+	local old_from = draw_from_region(sprite)
 	drystal.draw_image(sprite.x, sprite.y, sprite.w, sprite.h, x, y, w, h)
+	restore_draw_from(old_from)
 end
 
 function drystal.draw_circle(cx, cy, r)
@@ -0,0 +1,130 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef BUILD_HEADLESS
+#include <assert.h>
+#include <errno.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "headless.h"
+#include "log.h"
+
+log_category("headless");
+
+static struct {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface;
+} headless = {
+	EGL_NO_DISPLAY,
+	EGL_NO_CONTEXT,
+	EGL_NO_SURFACE,
+};
+
+static EGLDisplay headless_get_display(void)
+{
+#ifdef EGL_MESA_platform_surfaceless
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+
+	get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (get_platform_display) {
+		EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (display != EGL_NO_DISPLAY)
+			return display;
+	}
+#endif
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+int headless_init(void)
+{
+	static const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE,
+	};
+	static const EGLint context_attribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE,
+	};
+	static const EGLint pbuffer_attribs[] = {
+		EGL_WIDTH, 1,
+		EGL_HEIGHT, 1,
+		EGL_NONE,
+	};
+	EGLConfig config;
+	EGLint count;
+
+	headless.display = headless_get_display();
+	if (headless.display == EGL_NO_DISPLAY) {
+		log_error("No EGL display available");
+		return -ENODEV;
+	}
+	if (!eglInitialize(headless.display, NULL, NULL)) {
+		log_error("Cannot initialize EGL: 0x%x", eglGetError());
+		headless.display = EGL_NO_DISPLAY;
+		return -ENODEV;
+	}
+	if (!eglBindAPI(EGL_OPENGL_ES_API)
+	    || !eglChooseConfig(headless.display, config_attribs, &config, 1, &count)
+	    || count == 0) {
+		log_error("No EGL configuration supports GLES2");
+		headless_free();
+		return -ENOTSUP;
+	}
+
+	headless.context = eglCreateContext(headless.display, config, EGL_NO_CONTEXT, context_attribs);
+	if (headless.context == EGL_NO_CONTEXT) {
+		log_error("Cannot create the GLES2 context: 0x%x", eglGetError());
+		headless_free();
+		return -ENOTSUP;
+	}
+
+	// everything is drawn on the screen surface, this pbuffer is never read
+	headless.surface = eglCreatePbufferSurface(headless.display, config, pbuffer_attribs);
+	if (!eglMakeCurrent(headless.display, headless.surface, headless.surface, headless.context)) {
+		log_error("Cannot use the GLES2 context: 0x%x", eglGetError());
+		headless_free();
+		return -ENOTSUP;
+	}
+
+	log_debug("Headless rendering with %s", eglQueryString(headless.display, EGL_VENDOR));
+	return 0;
+}
+
+void headless_free(void)
+{
+	if (headless.display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (headless.surface != EGL_NO_SURFACE)
+		eglDestroySurface(headless.display, headless.surface);
+	if (headless.context != EGL_NO_CONTEXT)
+		eglDestroyContext(headless.display, headless.context);
+	eglTerminate(headless.display);
+
+	headless.display = EGL_NO_DISPLAY;
+	headless.context = EGL_NO_CONTEXT;
+	headless.surface = EGL_NO_SURFACE;
+}
+
+#endif
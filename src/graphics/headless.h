@@ -0,0 +1,29 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifdef BUILD_HEADLESS
+
+/*
+ * Creates a GLES2 context without any window, with EGL on the surfaceless
+ * Mesa platform if available (or the default display otherwise).
+ * Set LIBGL_ALWAYS_SOFTWARE=1 to force the software rasterizer.
+ */
+int headless_init(void);
+void headless_free(void);
+
+#endif
@@ -41,9 +41,13 @@ const char* DEFAULT_VERTEX_SHADER = SHADER_STRING
 attribute vec2 position;	// position of the vertice
 attribute vec4 color;		// color of the vertice
 attribute vec2 texCoord;	// texture coordinates
+attribute float blend;		// 1 for additive blending, only used with premultiplied alpha
+attribute float texIndex;	// sampler of the vertice, only used with texture batching
 
 varying vec4 fColor;
 varying vec2 fTexCoord;
+varying float fBlend;
+varying float fTexIndex;
 
 uniform float cameraDx;
 uniform float cameraDy;
@@ -59,6 +63,8 @@ void main()
 	gl_Position = vec4(position2d, 0.0, 1.0);
 	fColor = color;
 	fTexCoord = texCoord / sourceSize;
+	fBlend = blend;
+	fTexIndex = texIndex;
 }
 );
 
@@ -90,6 +96,92 @@ void main()
 }
 );
 
+/*
+ * With premultiplied alpha, alpha and additive blending share the same
+ * glBlendFunc: additive fragments only output an alpha of zero.
+ */
+const char* PREMULTIPLIED_FRAGMENT_SHADER_COLOR = SHADER_STRING
+(
+varying vec4 fColor;
+varying vec2 fTexCoord;
+varying float fBlend;
+
+void main()
+{
+	gl_FragColor = vec4(fColor.rgb * fColor.a, fColor.a * (1. - fBlend));
+}
+);
+
+const char* PREMULTIPLIED_FRAGMENT_SHADER_TEX = SHADER_STRING
+(
+uniform sampler2D tex;
+
+varying vec4 fColor;
+varying vec2 fTexCoord;
+varying float fBlend;
+
+void main()
+{
+	vec4 color;
+	vec4 texval = texture2D(tex, fTexCoord); // already premultiplied
+	color.rgb = mix(texval.rgb, texval.a * fColor.rgb, vec3(1.) - fColor.rgb) * fColor.a;
+	color.a = texval.a * fColor.a * (1. - fBlend);
+	gl_FragColor = color;
+}
+);
+
+/*
+ * Texture batching: the vertices carry the index of their sampler.
+ * GLSL ES only allows indexing samplers with constants.
+ */
+#define SAMPLE_TEXTURES \
+uniform sampler2D textures[8]; \
+\
+varying vec4 fColor; \
+varying vec2 fTexCoord; \
+varying float fBlend; \
+varying float fTexIndex; \
+\
+vec4 sample_texture() \
+{ \
+	if (fTexIndex < 0.5) return texture2D(textures[0], fTexCoord); \
+	if (fTexIndex < 1.5) return texture2D(textures[1], fTexCoord); \
+	if (fTexIndex < 2.5) return texture2D(textures[2], fTexCoord); \
+	if (fTexIndex < 3.5) return texture2D(textures[3], fTexCoord); \
+	if (fTexIndex < 4.5) return texture2D(textures[4], fTexCoord); \
+	if (fTexIndex < 5.5) return texture2D(textures[5], fTexCoord); \
+	if (fTexIndex < 6.5) return texture2D(textures[6], fTexCoord); \
+	return texture2D(textures[7], fTexCoord); \
+}
+
+const char* MULTITEXTURE_FRAGMENT_SHADER_TEX = SHADER_STRING
+(
+SAMPLE_TEXTURES
+
+void main()
+{
+	vec4 color;
+	vec4 texval = sample_texture();
+	color.rgb = mix(texval.rgb, fColor.rgb, vec3(1.) - fColor.rgb);
+	color.a = texval.a * fColor.a;
+	gl_FragColor = color;
+}
+);
+
+const char* PREMULTIPLIED_MULTITEXTURE_FRAGMENT_SHADER_TEX = SHADER_STRING
+(
+SAMPLE_TEXTURES
+
+void main()
+{
+	vec4 color;
+	vec4 texval = sample_texture();
+	color.rgb = mix(texval.rgb, texval.a * fColor.rgb, vec3(1.) - fColor.rgb) * fColor.a;
+	color.a = texval.a * fColor.a * (1. - fBlend);
+	gl_FragColor = color;
+}
+);
+
 Shader *shader_new(GLuint prog_color, GLuint prog_tex, GLuint vert, GLuint frag_color, GLuint frag_tex)
 {
 	Shader *s = new(Shader, 1);
@@ -115,6 +207,19 @@ Shader *shader_new(GLuint prog_color, GLuint prog_tex, GLuint vert, GLuint frag_
 	s->vars[VAR_LOCATION_TEX].destinationSizeLocation = glGetUniformLocation(prog_tex, "destinationSize");
 	s->vars[VAR_LOCATION_TEX].sourceSizeLocation = glGetUniformLocation(prog_tex, "sourceSize");
 
+	s->texturesLocation = glGetUniformLocation(prog_tex, "textures");
+	if (s->texturesLocation >= 0) {
+		GLint units[SHADER_MAX_TEXTURES];
+		GLint prog;
+		for (int i = 0; i < SHADER_MAX_TEXTURES; i++)
+			units[i] = i;
+
+		glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+		glUseProgram(prog_tex);
+		glUniform1iv(s->texturesLocation, SHADER_MAX_TEXTURES, units);
+		glUseProgram(prog);
+	}
+
 	return s;
 }
 
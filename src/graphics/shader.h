@@ -16,6 +16,8 @@
  */
 #pragma once
 
+#include <stddef.h>
+
 #define GL_GLEXT_PROTOTYPES
 #ifndef EMSCRIPTEN
 #include <SDL2/SDL_opengles2.h>
@@ -29,12 +31,21 @@ extern const char* SHADER_PREFIX;
 extern const char* DEFAULT_VERTEX_SHADER;
 extern const char* DEFAULT_FRAGMENT_SHADER_COLOR;
 extern const char* DEFAULT_FRAGMENT_SHADER_TEX;
+extern const char* PREMULTIPLIED_FRAGMENT_SHADER_COLOR;
+extern const char* PREMULTIPLIED_FRAGMENT_SHADER_TEX;
+extern const char* MULTITEXTURE_FRAGMENT_SHADER_TEX;
+extern const char* PREMULTIPLIED_MULTITEXTURE_FRAGMENT_SHADER_TEX;
+
+// GLES2 guarantees 8 texture units in fragment shaders
+#define SHADER_MAX_TEXTURES 8
 
 typedef enum AttrLocationIndex {
 	// WebGL wants 0 as an attribute, so here it is
 	ATTR_LOCATION_POSITION = 0,
 	ATTR_LOCATION_COLOR,
 	ATTR_LOCATION_TEXCOORD,
+	ATTR_LOCATION_BLEND,
+	ATTR_LOCATION_TEXINDEX,
 } AttrLocationIndex;
 
 enum VarLocationIndex {
@@ -58,7 +69,9 @@ struct Shader {
 		GLuint destinationSizeLocation;
 		GLuint sourceSizeLocation;
 	} vars[2];
+	GLint texturesLocation; // -1 if the tex program samples from a single texture
 	int ref;
+	size_t registry_index; // see object_registry.h
 
 };
 Shader *shader_new(GLuint prog_color, GLuint prog_tex, GLuint vert, GLuint frag_color, GLuint frag_tex);
@@ -27,7 +27,7 @@
 
 log_category("shader");
 
-IMPLEMENT_PUSHPOP(Shader, shader)
+IMPLEMENT_PUSHPOP(Shader, shader, OBJECT_SHADER)
 
 int mlua_new_shader(lua_State* L)
 {
@@ -88,6 +88,7 @@ int mlua_free_shader(lua_State* L)
 	assert(L);
 
 	Shader* shader = pop_shader(L, 1);
+	object_registry_remove(OBJECT_SHADER, &shader->registry_index);
 	display_free_shader(shader);
 	return 0;
 }
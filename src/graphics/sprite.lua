@@ -71,6 +71,16 @@ function Sprite:draw()
 	local x2, y2 = self._x2, self._y2
 	local x3, y3 = self._x3, self._y3
 	local x4, y4 = self._x4, self._y4
+	local old_from
+	local page = self.source.surface
+	if page then -- atlas region, drawn from its page
+		old_from = drystal.current_draw_from
+		if old_from ~= page then
+			page:draw_from()
+		else
+			old_from = nil
+		end
+	end
 	local xi = self.source.x
 	local yi = self.source.y
 	local xi2 = self.source.x + self.source.w
@@ -85,5 +95,8 @@ function Sprite:draw()
 
 	drystal.draw_quad(xi, yi, xi2, yi, xi2, yi2, xi, yi2,
 			x1, y1, x2,  y2, x3,  y3,  x4, y4)
+	if old_from then
+		old_from:draw_from()
+	end
 end
 
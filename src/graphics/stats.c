@@ -0,0 +1,42 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+
+#include "stats.h"
+
+RenderStats render_stats;
+RenderStats render_stats_last_frame;
+
+const char *FLUSH_REASON_NAMES[FLUSH_REASON_COUNT] = {
+	[FLUSH_FULL] = "full",
+	[FLUSH_TEXTURE_MODE] = "texture_mode",
+	[FLUSH_CAMERA] = "camera",
+	[FLUSH_BLEND] = "blend",
+	[FLUSH_DRAW_FROM] = "draw_from",
+	[FLUSH_DRAW_ON] = "draw_on",
+	[FLUSH_SHADER] = "shader",
+	[FLUSH_BUFFER] = "buffer",
+	[FLUSH_BACKGROUND] = "background",
+	[FLUSH_FREE_SURFACE] = "free_surface",
+	[FLUSH_FLIP] = "flip",
+};
+
+void render_stats_next_frame(void)
+{
+	render_stats_last_frame = render_stats;
+	memset(&render_stats, 0, sizeof(render_stats));
+}
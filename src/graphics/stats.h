@@ -0,0 +1,59 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+typedef struct RenderStats RenderStats;
+
+enum FlushReason {
+	FLUSH_FULL,
+	FLUSH_TEXTURE_MODE,
+	FLUSH_CAMERA,
+	FLUSH_BLEND,
+	FLUSH_DRAW_FROM,
+	FLUSH_DRAW_ON,
+	FLUSH_SHADER,
+	FLUSH_BUFFER,
+	FLUSH_BACKGROUND,
+	FLUSH_FREE_SURFACE,
+	FLUSH_FLIP,
+
+	FLUSH_REASON_COUNT,
+};
+typedef enum FlushReason FlushReason;
+
+struct RenderStats {
+	unsigned long draw_calls;
+	unsigned long vertices;
+	unsigned long uploaded_bytes;
+	unsigned long orphans;
+	unsigned long texture_binds;
+	unsigned long fbo_switches;
+	unsigned long batched_blend_changes; // blend changes that did not need a flush
+	unsigned long flushes[FLUSH_REASON_COUNT];
+};
+
+/*
+ * Counters of the frame being rendered, they are moved to
+ * render_stats_last_frame and reset by render_stats_next_frame(),
+ * which is called at each display_flip().
+ */
+extern RenderStats render_stats;
+extern RenderStats render_stats_last_frame;
+
+extern const char *FLUSH_REASON_NAMES[FLUSH_REASON_COUNT];
+
+void render_stats_next_frame(void);
@@ -26,6 +26,8 @@
 #include "util.h"
 #include "macro.h"
 #include "opengl_util.h"
+#include "stats.h"
+#include "profiler.h"
 
 log_category("graphics");
 
@@ -243,6 +245,7 @@ void surface_draw_on(Surface *s)
 	} else {
 		glBindFramebuffer(GL_FRAMEBUFFER, s->fbo);
 	}
+	render_stats.fbo_switches += 1;
 }
 
 void surface_draw_from(Surface *s)
@@ -250,6 +253,7 @@ void surface_draw_from(Surface *s)
 	assert(s);
 
 	glBindTexture(GL_TEXTURE_2D, s->tex);
+	render_stats.texture_binds += 1;
 
 	if (!s->has_mipmap && s->filter >= FILTER_BILINEAR && !s->npot) {
 		glGenerateMipmap(GL_TEXTURE_2D);
@@ -282,14 +286,9 @@ void surface_set_filter(Surface *s, FilterMode new_filter, Surface *current_surf
 	}
 }
 
-void surface_get_pixel(Surface *s, unsigned int x, unsigned int y,
-					   int *red, int *green, int *blue, int *alpha, Surface *current_on)
+const unsigned char *surface_get_pixels(Surface *s, Surface *current_on)
 {
 	assert(s);
-	assert(red);
-	assert(green);
-	assert(blue);
-	assert(alpha);
 	assert(current_on);
 	assert(s != current_on);
 
@@ -306,6 +305,77 @@ void surface_get_pixel(Surface *s, unsigned int x, unsigned int y,
 		surface_draw_on(current_on);
 	}
 
+	return s->pixels;
+}
+
+int surface_save_png(Surface *s, const char *filename, Surface *current_on)
+{
+	png_structp png_ptr;
+	png_infop info_ptr;
+	unsigned char *pixels;
+	FILE *f;
+	int r = 0;
+
+	assert(s);
+	assert(filename);
+
+	f = fopen(filename, "wb");
+	if (!f)
+		return -errno;
+
+	pixels = new(unsigned char, s->w * s->h * 4);
+	if (s != current_on)
+		surface_draw_on(s);
+	glReadPixels(0, 0, s->w, s->h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	GLDEBUG();
+	if (s != current_on)
+		surface_draw_on(current_on);
+
+	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (!png_ptr) {
+		r = -ENOMEM;
+		goto finish;
+	}
+	info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr) {
+		png_destroy_write_struct(&png_ptr, NULL);
+		r = -ENOMEM;
+		goto finish;
+	}
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		r = -EIO;
+		goto finish;
+	}
+
+	png_init_io(png_ptr, f);
+	png_set_IHDR(png_ptr, info_ptr, s->w, s->h, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+	             PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png_ptr, info_ptr);
+	// surfaces are stored from top to bottom, like PNG rows
+	for (unsigned int y = 0; y < s->h; y++)
+		png_write_row(png_ptr, pixels + y * s->w * 4);
+	png_write_end(png_ptr, NULL);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+
+finish:
+	free(pixels);
+	if (fclose(f) != 0 && r == 0)
+		r = -errno;
+	return r;
+}
+
+void surface_get_pixel(Surface *s, unsigned int x, unsigned int y,
+					   int *red, int *green, int *blue, int *alpha, Surface *current_on)
+{
+	assert(s);
+	assert(red);
+	assert(green);
+	assert(blue);
+	assert(alpha);
+
+	surface_get_pixels(s, current_on);
+
 	size_t idx = (x + y * s->w) * 4;
 	*red = s->pixels[idx];
 	*green = s->pixels[idx + 1];
@@ -313,7 +383,77 @@ void surface_get_pixel(Surface *s, unsigned int x, unsigned int y,
 	*alpha = s->pixels[idx + 3];
 }
 
-int surface_load(const char *filename, Surface **surface, Surface *current_surface)
+void surface_premultiply_alpha(unsigned char *pixels, unsigned int w, unsigned int h, SurfaceFormat format)
+{
+	assert(pixels);
+
+	size_t n = w * h;
+	if (format == FORMAT_RGBA) {
+		for (size_t i = 0; i < n; i++) {
+			unsigned char *p = pixels + i * 4;
+			p[0] = (p[0] * p[3] + 127) / 255;
+			p[1] = (p[1] * p[3] + 127) / 255;
+			p[2] = (p[2] * p[3] + 127) / 255;
+		}
+	} else if (format == FORMAT_LUMINANCE_ALPHA) {
+		for (size_t i = 0; i < n; i++) {
+			unsigned char *p = pixels + i * 2;
+			p[0] = (p[0] * p[1] + 127) / 255;
+		}
+	}
+}
+
+int surface_load_pixels(const char *filename, unsigned char **pixels, unsigned int *w, unsigned int *h, bool premultiply)
+{
+	assert(filename);
+	assert(pixels);
+	assert(w);
+	assert(h);
+
+	SurfaceFormat format;
+	GLint components;
+	GLubyte *data;
+	int r;
+
+	r = png_load(filename, &data, w, h, &format, &components);
+	if (r < 0)
+		return r;
+
+	if (format == FORMAT_RGBA) {
+		*pixels = data;
+	} else {
+		size_t n = *w * *h;
+		*pixels = new(unsigned char, n * 4);
+		for (size_t i = 0; i < n; i++) {
+			const GLubyte *src = data + i * components;
+			unsigned char *dst = *pixels + i * 4;
+			switch (format) {
+				case FORMAT_LUMINANCE:
+					dst[0] = dst[1] = dst[2] = src[0];
+					dst[3] = 255;
+					break;
+				case FORMAT_LUMINANCE_ALPHA:
+					dst[0] = dst[1] = dst[2] = src[0];
+					dst[3] = src[1];
+					break;
+				case FORMAT_RGB:
+				default:
+					dst[0] = src[0];
+					dst[1] = src[1];
+					dst[2] = src[2];
+					dst[3] = 255;
+					break;
+			}
+		}
+		free(data);
+	}
+
+	if (premultiply)
+		surface_premultiply_alpha(*pixels, *w, *h, FORMAT_RGBA);
+	return 0;
+}
+
+int surface_load(const char *filename, Surface **surface, Surface *current_surface, bool premultiply)
 {
 	assert(filename);
 	assert(surface);
@@ -324,6 +464,7 @@ int surface_load(const char *filename, Surface **surface, Surface *current_surfa
 	GLubyte *data;
 	int r;
 
+	PROFILER_BEGIN(load);
 	r = png_load(filename, &data, &w, &h, &format, &internal_format);
 	if (r < 0)
 		return r;
@@ -332,12 +473,16 @@ int surface_load(const char *filename, Surface **surface, Surface *current_surfa
 		return -E2BIG;
 	}
 
+	if (premultiply)
+		surface_premultiply_alpha(data, w, h, format);
+
 	GLuint potw = pow(2, (int) ceil(log(w) / log(2)));
 	GLuint poth = pow(2, (int) ceil(log(h) / log(2)));
 	*surface = surface_new(w, h, potw, poth, format, data, current_surface, NULL);
 	(*surface)->filename = xstrdup(filename);
 
 	free(data);
+	PROFILER_END(load, "load_surface");
 	return 0;
 }
 
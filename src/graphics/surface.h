@@ -18,6 +18,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifndef EMSCRIPTEN
 #include <SDL2/SDL_opengles2.h>
@@ -56,6 +57,7 @@ struct Surface {
 	bool has_mipmap;
 	bool npot;
 	int ref;
+	size_t registry_index; // see object_registry.h
 
 	GLuint tex;
 	GLuint fbo;
@@ -78,6 +80,9 @@ void surface_draw_from(Surface *s);
 void surface_set_filter(Surface *s, FilterMode filter, Surface *current_surface);
 void surface_get_pixel(Surface *s, unsigned int x, unsigned int y,
 		       int *red, int *green, int *blue, int *alpha, Surface *current_on);
+// RGBA pixels of the surface, read back from the graphic card if needed
+const unsigned char *surface_get_pixels(Surface *s, Surface *current_on);
+int surface_save_png(Surface *s, const char *filename, Surface *current_on);
 
 static inline void surface_get_size(const Surface *s, unsigned int *w, unsigned int *h)
 {
@@ -87,5 +92,8 @@ static inline void surface_get_size(const Surface *s, unsigned int *w, unsigned
 	*h = s->h;
 }
 
-int surface_load(const char* filename, Surface **surface, Surface *current_surface);
+void surface_premultiply_alpha(unsigned char *pixels, unsigned int w, unsigned int h, SurfaceFormat format);
+// loads a PNG as RGBA pixels
+int surface_load_pixels(const char *filename, unsigned char **pixels, unsigned int *w, unsigned int *h, bool premultiply);
+int surface_load(const char* filename, Surface **surface, Surface *current_surface, bool premultiply);
 
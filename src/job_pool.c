@@ -0,0 +1,182 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#ifndef EMSCRIPTEN
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "job_pool.h"
+#include "macro.h"
+#include "log.h"
+
+log_category("jobs");
+
+static void run_jobs(JobFunction function, void *data, size_t count, size_t *next)
+{
+	size_t i;
+
+	while ((i = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED)) < count)
+		function(data, i);
+}
+
+#ifndef EMSCRIPTEN
+
+static struct {
+	bool started;
+	pthread_t threads[JOB_POOL_MAX_WORKERS];
+	unsigned workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned long generation;
+	unsigned busy; // workers still running the current jobs
+	bool quit;
+
+	JobFunction function;
+	void *data;
+	size_t count;
+	size_t next;
+} pool = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.start = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+static void *worker_loop(_unused_ void *arg)
+{
+	unsigned long generation = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&pool.mutex);
+		while (!pool.quit && pool.generation == generation)
+			pthread_cond_wait(&pool.start, &pool.mutex);
+		if (pool.quit) {
+			pthread_mutex_unlock(&pool.mutex);
+			return NULL;
+		}
+		generation = pool.generation;
+		pthread_mutex_unlock(&pool.mutex);
+
+		run_jobs(pool.function, pool.data, pool.count, &pool.next);
+
+		pthread_mutex_lock(&pool.mutex);
+		pool.busy -= 1;
+		if (!pool.busy)
+			pthread_cond_signal(&pool.done);
+		pthread_mutex_unlock(&pool.mutex);
+	}
+}
+
+static void job_pool_start(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned wanted = cpus > 1 ? cpus - 1 : 0;
+
+	pool.started = true;
+	if (wanted > JOB_POOL_MAX_WORKERS)
+		wanted = JOB_POOL_MAX_WORKERS;
+
+	while (pool.workers < wanted) {
+		int r = pthread_create(&pool.threads[pool.workers], NULL, worker_loop, NULL);
+		if (r) {
+			log_error("Cannot create worker thread: %s", strerror(r));
+			break;
+		}
+		pool.workers++;
+	}
+	log_debug("%u workers", pool.workers);
+}
+
+void job_pool_run(JobFunction function, void *data, size_t count)
+{
+	assert(function);
+
+	if (!pool.started)
+		job_pool_start();
+
+	if (count <= 1 || !pool.workers) {
+		size_t next = 0;
+		run_jobs(function, data, count, &next);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.function = function;
+	pool.data = data;
+	pool.count = count;
+	pool.next = 0;
+	pool.busy = pool.workers;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.mutex);
+
+	run_jobs(function, data, count, &pool.next);
+
+	pthread_mutex_lock(&pool.mutex);
+	while (pool.busy)
+		pthread_cond_wait(&pool.done, &pool.mutex);
+	pthread_mutex_unlock(&pool.mutex);
+}
+
+unsigned job_pool_get_workers(void)
+{
+	if (!pool.started)
+		job_pool_start();
+
+	return pool.workers;
+}
+
+void job_pool_free(void)
+{
+	pthread_mutex_lock(&pool.mutex);
+	pool.quit = true;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.mutex);
+
+	for (unsigned i = 0; i < pool.workers; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	pool.workers = 0;
+	pool.started = false;
+	pool.quit = false;
+}
+
+#else
+
+void job_pool_run(JobFunction function, void *data, size_t count)
+{
+	size_t next = 0;
+
+	assert(function);
+
+	run_jobs(function, data, count, &next);
+}
+
+unsigned job_pool_get_workers(void)
+{
+	return 0;
+}
+
+void job_pool_free(void)
+{
+}
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#define JOB_POOL_MAX_WORKERS 16
+
+typedef void (*JobFunction)(void *data, size_t index);
+
+/*
+ * Calls function(data, i) for each i in [0, count) across the worker
+ * threads and the calling thread, and returns once all the calls are done.
+ * The workers are started on the first call. Without thread support,
+ * the calls are made serially.
+ */
+void job_pool_run(JobFunction function, void *data, size_t count);
+unsigned job_pool_get_workers(void);
+void job_pool_free(void);
@@ -0,0 +1,218 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lua_allocator.h"
+#include "util.h"
+
+#define MAX_SMALL_SIZE (LUA_ALLOCATOR_CLASSES * LUA_ALLOCATOR_GRANULARITY)
+
+typedef struct FreeBlock FreeBlock;
+typedef struct Slab Slab;
+
+struct FreeBlock {
+	FreeBlock *next;
+};
+
+struct Slab {
+	Slab *next;
+	// followed by the blocks, the header keeps them aligned
+	char padding[LUA_ALLOCATOR_GRANULARITY * 2 - sizeof(Slab *)];
+};
+
+struct LuaAllocator {
+	FreeBlock *free_lists[LUA_ALLOCATOR_CLASSES];
+	Slab *slabs;
+	// remaining bytes of the last slab, not yet in a free list
+	char *slab_cursor;
+	size_t slab_remaining;
+
+	LuaAllocatorStats stats;
+	unsigned long frame_allocations;
+	size_t frame_allocated_bytes;
+};
+
+static bool is_small(size_t size)
+{
+	return size <= MAX_SMALL_SIZE;
+}
+
+static unsigned int size_class(size_t size)
+{
+	assert(size > 0);
+	assert(is_small(size));
+
+	return (size - 1) / LUA_ALLOCATOR_GRANULARITY;
+}
+
+static size_t class_size(unsigned int c)
+{
+	return (c + 1) * LUA_ALLOCATOR_GRANULARITY;
+}
+
+static void *alloc_small(LuaAllocator *a, size_t size)
+{
+	unsigned int c = size_class(size);
+	size_t block_size = class_size(c);
+	FreeBlock *block = a->free_lists[c];
+
+	if (block) {
+		a->free_lists[c] = block->next;
+		return block;
+	}
+
+	if (a->slab_remaining < block_size) {
+		Slab *slab = malloc(LUA_ALLOCATOR_SLAB_SIZE);
+		if (!slab)
+			return NULL;
+
+		// the end of the previous slab is lost, it is smaller than a block
+		slab->next = a->slabs;
+		a->slabs = slab;
+		a->slab_cursor = (char *) (slab + 1);
+		a->slab_remaining = LUA_ALLOCATOR_SLAB_SIZE - sizeof(Slab);
+		a->stats.slab_bytes += LUA_ALLOCATOR_SLAB_SIZE;
+	}
+
+	block = (FreeBlock *) a->slab_cursor;
+	a->slab_cursor += block_size;
+	a->slab_remaining -= block_size;
+	return block;
+}
+
+static void free_small(LuaAllocator *a, void *ptr, size_t size)
+{
+	unsigned int c = size_class(size);
+	FreeBlock *block = ptr;
+
+	block->next = a->free_lists[c];
+	a->free_lists[c] = block;
+}
+
+static void *alloc_block(LuaAllocator *a, size_t size)
+{
+	return is_small(size) ? alloc_small(a, size) : malloc(size);
+}
+
+static void free_block(LuaAllocator *a, void *ptr, size_t size)
+{
+	if (is_small(size))
+		free_small(a, ptr, size);
+	else
+		free(ptr);
+}
+
+LuaAllocator *lua_allocator_new(void)
+{
+	return new0(LuaAllocator, 1);
+}
+
+void lua_allocator_free(LuaAllocator *a)
+{
+	if (!a)
+		return;
+
+	while (a->slabs) {
+		Slab *next = a->slabs->next;
+		free(a->slabs);
+		a->slabs = next;
+	}
+	free(a);
+}
+
+void *lua_allocator_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	LuaAllocator *a = ud;
+	void *block;
+
+	// osize is the type of the object when ptr is NULL
+	if (!ptr)
+		osize = 0;
+
+	if (nsize == 0) {
+		if (ptr) {
+			free_block(a, ptr, osize);
+			a->stats.live_bytes -= osize;
+			a->stats.frees++;
+		}
+		return NULL;
+	}
+
+	if (!ptr) {
+		block = alloc_block(a, nsize);
+		if (!block)
+			return NULL;
+		a->stats.allocations++;
+		a->frame_allocations++;
+	} else if (is_small(osize) && is_small(nsize) && size_class(osize) == size_class(nsize)) {
+		block = ptr;
+	} else if (!is_small(osize) && !is_small(nsize)) {
+		block = realloc(ptr, nsize);
+		if (!block) {
+			if (nsize > osize)
+				return NULL;
+			block = ptr;
+		}
+	} else {
+		block = alloc_block(a, nsize);
+		if (block) {
+			memcpy(block, ptr, osize < nsize ? osize : nsize);
+			free_block(a, ptr, osize);
+		} else if (nsize <= osize) {
+			/*
+			 * Lua expects a shrink to never fail, the block stays in place.
+			 * It is large enough for the class of nsize, so it can be freed
+			 * into that class later, a malloc'd block is then never given
+			 * back to the system.
+			 */
+			block = ptr;
+		} else {
+			return NULL;
+		}
+	}
+
+	a->stats.live_bytes += nsize;
+	a->stats.live_bytes -= osize;
+	if (a->stats.live_bytes > a->stats.peak_bytes)
+		a->stats.peak_bytes = a->stats.live_bytes;
+	if (nsize > osize) {
+		a->frame_allocated_bytes += nsize - osize;
+		a->stats.allocated_bytes += nsize - osize;
+	}
+	return block;
+}
+
+void lua_allocator_end_frame(LuaAllocator *a)
+{
+	assert(a);
+
+	a->stats.frame_allocations = a->frame_allocations;
+	a->stats.frame_allocated_bytes = a->frame_allocated_bytes;
+	a->frame_allocations = 0;
+	a->frame_allocated_bytes = 0;
+}
+
+void lua_allocator_get_stats(const LuaAllocator *a, LuaAllocatorStats *stats)
+{
+	assert(a);
+	assert(stats);
+
+	*stats = a->stats;
+}
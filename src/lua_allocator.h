@@ -0,0 +1,55 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * lua_Alloc serving the small blocks from free lists of size classes,
+ * carved from slabs. The slabs are never returned to the system before
+ * lua_allocator_free, the larger blocks use malloc.
+ */
+#define LUA_ALLOCATOR_GRANULARITY 8
+#define LUA_ALLOCATOR_CLASSES 32 // up to 256 bytes
+#define LUA_ALLOCATOR_SLAB_SIZE (64 * 1024)
+
+typedef struct LuaAllocatorStats LuaAllocatorStats;
+typedef struct LuaAllocator LuaAllocator;
+
+struct LuaAllocatorStats {
+	// requested by Lua
+	size_t live_bytes;
+	size_t peak_bytes;
+	// reserved for the small blocks
+	size_t slab_bytes;
+	unsigned long allocations;
+	unsigned long frees;
+	size_t allocated_bytes;
+	// during the last frame
+	unsigned long frame_allocations;
+	size_t frame_allocated_bytes;
+};
+
+LuaAllocator *lua_allocator_new(void);
+// call it after lua_close
+void lua_allocator_free(LuaAllocator *a);
+
+// the ud argument is the LuaAllocator
+void *lua_allocator_alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+void lua_allocator_end_frame(LuaAllocator *a);
+void lua_allocator_get_stats(const LuaAllocator *a, LuaAllocatorStats *stats);
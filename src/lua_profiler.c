@@ -0,0 +1,320 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#ifndef EMSCRIPTEN
+#include <sys/time.h>
+#endif
+
+#include "lua_profiler.h"
+#include "util.h"
+
+#define FOLDED_STACK_LENGTH 4096
+#ifdef EMSCRIPTEN
+#define EMSCRIPTEN_HOOK_COUNT 1000
+#endif
+
+typedef struct FoldedStack FoldedStack;
+
+struct FoldedStack {
+	char *stack;
+	unsigned long count;
+};
+
+static struct {
+	lua_State *L;
+	bool running;
+	unsigned long samples;
+	// read by the signal handler
+	volatile sig_atomic_t lua_depth;
+	volatile sig_atomic_t outside_samples;
+	volatile sig_atomic_t hook_armed;
+	// the hook set by the game, restored after each sample
+	lua_Hook old_hook;
+	int old_hook_mask;
+	int old_hook_count;
+
+	// open addressing, stacks_size is a power of 2
+	FoldedStack *stacks;
+	size_t stacks_count;
+	size_t stacks_size;
+#ifndef EMSCRIPTEN
+	struct sigaction old_action;
+#endif
+} lua_profiler;
+
+static unsigned long hash_string(const char *s)
+{
+	unsigned long h = 2166136261UL; // FNV-1a
+
+	for (; *s; s++) {
+		h ^= (unsigned char) *s;
+		h *= 16777619UL;
+	}
+	return h;
+}
+
+static FoldedStack *find_stack(FoldedStack *stacks, size_t size, const char *stack)
+{
+	size_t i = hash_string(stack) & (size - 1);
+
+	while (stacks[i].stack && !streq(stacks[i].stack, stack))
+		i = (i + 1) & (size - 1);
+	return &stacks[i];
+}
+
+static void grow_stacks(void)
+{
+	size_t size = lua_profiler.stacks_size ? lua_profiler.stacks_size * 2 : 256;
+	FoldedStack *stacks = new0(FoldedStack, size);
+
+	for (size_t i = 0; i < lua_profiler.stacks_size; i++) {
+		FoldedStack *old = &lua_profiler.stacks[i];
+		if (old->stack)
+			*find_stack(stacks, size, old->stack) = *old;
+	}
+	free(lua_profiler.stacks);
+	lua_profiler.stacks = stacks;
+	lua_profiler.stacks_size = size;
+}
+
+static void add_sample(const char *stack)
+{
+	FoldedStack *entry;
+
+	if ((lua_profiler.stacks_count + 1) * 4 > lua_profiler.stacks_size * 3)
+		grow_stacks();
+
+	entry = find_stack(lua_profiler.stacks, lua_profiler.stacks_size, stack);
+	if (!entry->stack) {
+		entry->stack = xstrdup(stack);
+		lua_profiler.stacks_count++;
+	}
+	entry->count++;
+	lua_profiler.samples++;
+}
+
+// appends a frame like "update (main.lua:12)", ';' is reserved by the folded format
+static size_t format_frame(char *buffer, size_t size, lua_Debug *ar)
+{
+	const char *name = ar->name ? ar->name : streq(ar->what, "main") ? "main chunk" : "?";
+	int n;
+
+	if (streq(ar->what, "C"))
+		n = snprintf(buffer, size, "%s [C]", name);
+	else
+		n = snprintf(buffer, size, "%s (%s:%d)", name, ar->short_src, ar->linedefined);
+	if (n < 0)
+		return 0;
+	if ((size_t) n >= size)
+		n = size - 1;
+
+	for (int i = 0; i < n; i++) {
+		if (buffer[i] == ';')
+			buffer[i] = ',';
+	}
+	return n;
+}
+
+static void sample_stack(lua_State *L)
+{
+	lua_Debug frames[LUA_PROFILER_MAX_DEPTH];
+	char stack[FOLDED_STACK_LENGTH];
+	size_t length = 0;
+	int depth = 0;
+
+	while (depth < LUA_PROFILER_MAX_DEPTH && lua_getstack(L, depth, &frames[depth])) {
+		lua_getinfo(L, "Sn", &frames[depth]);
+		depth++;
+	}
+	if (depth == 0)
+		return;
+
+	// outermost frame first
+	for (int i = depth - 1; i >= 0 && length + 1 < sizeof(stack); i--) {
+		if (i != depth - 1)
+			stack[length++] = ';';
+		length += format_frame(stack + length, sizeof(stack) - length, &frames[i]);
+	}
+	stack[length] = '\0';
+
+	add_sample(stack);
+}
+
+static void clear_samples(void)
+{
+	for (size_t i = 0; i < lua_profiler.stacks_size; i++)
+		free(lua_profiler.stacks[i].stack);
+	free(lua_profiler.stacks);
+	lua_profiler.stacks = NULL;
+	lua_profiler.stacks_count = 0;
+	lua_profiler.stacks_size = 0;
+	lua_profiler.samples = 0;
+	lua_profiler.outside_samples = 0;
+}
+
+static void restore_old_hook(lua_State *L)
+{
+	lua_sethook(L, lua_profiler.old_hook, lua_profiler.old_hook_mask, lua_profiler.old_hook_count);
+}
+
+#ifndef EMSCRIPTEN
+static void lua_profiler_hook(lua_State *L, _unused_ lua_Debug *ar)
+{
+	// one shot, armed again by the next SIGPROF
+	lua_profiler.hook_armed = false;
+	restore_old_hook(L);
+	sample_stack(L);
+}
+
+static void lua_profiler_signal(_unused_ int sig)
+{
+	// the CPU time of the engine (display, audio, waiting for the next frame)
+	// would be accounted to the first Lua instruction run afterwards
+	if (!lua_profiler.lua_depth) {
+		lua_profiler.outside_samples++;
+		return;
+	}
+	// lua_sethook can be called asynchronously, see lua.c
+	lua_profiler.hook_armed = true;
+	lua_sethook(lua_profiler.L, lua_profiler_hook, LUA_MASKCOUNT, 1);
+}
+#else
+static void lua_profiler_hook(lua_State *L, _unused_ lua_Debug *ar)
+{
+	sample_stack(L);
+}
+#endif
+
+void lua_profiler_start(lua_State *L, unsigned int interval)
+{
+	assert(L);
+	assert(interval > 0);
+
+	if (lua_profiler.running)
+		lua_profiler_stop();
+	clear_samples();
+
+	lua_profiler.L = L;
+	lua_profiler.running = true;
+	lua_profiler.hook_armed = false;
+	lua_profiler.old_hook = lua_gethook(L);
+	lua_profiler.old_hook_mask = lua_gethookmask(L);
+	lua_profiler.old_hook_count = lua_gethookcount(L);
+
+#ifndef EMSCRIPTEN
+	struct sigaction action;
+	struct itimerval timer;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = lua_profiler_signal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGPROF, &action, &lua_profiler.old_action);
+
+	timer.it_interval.tv_sec = interval / 1000000;
+	timer.it_interval.tv_usec = interval % 1000000;
+	timer.it_value = timer.it_interval;
+	setitimer(ITIMER_PROF, &timer, NULL);
+#else
+	(void) interval;
+	lua_sethook(L, lua_profiler_hook, LUA_MASKCOUNT, EMSCRIPTEN_HOOK_COUNT);
+#endif
+}
+
+void lua_profiler_stop(void)
+{
+	if (!lua_profiler.running)
+		return;
+
+#ifndef EMSCRIPTEN
+	struct itimerval timer;
+
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	sigaction(SIGPROF, &lua_profiler.old_action, NULL);
+#endif
+	restore_old_hook(lua_profiler.L);
+	lua_profiler.running = false;
+}
+
+void lua_profiler_enter(void)
+{
+	lua_profiler.lua_depth++;
+}
+
+void lua_profiler_leave(void)
+{
+	assert(lua_profiler.lua_depth > 0);
+
+	lua_profiler.lua_depth--;
+#ifndef EMSCRIPTEN
+	// a sample armed at the very end of the call would land in the next one
+	if (!lua_profiler.lua_depth && lua_profiler.hook_armed) {
+		lua_profiler.hook_armed = false;
+		restore_old_hook(lua_profiler.L);
+		lua_profiler.outside_samples++;
+	}
+#endif
+}
+
+bool lua_profiler_is_running(void)
+{
+	return lua_profiler.running;
+}
+
+unsigned long lua_profiler_get_samples(void)
+{
+	return lua_profiler.samples;
+}
+
+int lua_profiler_write(const char *filename)
+{
+	FILE *f;
+
+	assert(filename);
+
+	f = fopen(filename, "w");
+	if (!f)
+		return -errno;
+
+	for (size_t i = 0; i < lua_profiler.stacks_size; i++) {
+		const FoldedStack *entry = &lua_profiler.stacks[i];
+		if (entry->stack)
+			fprintf(f, "%s %lu\n", entry->stack, entry->count);
+	}
+	if (lua_profiler.outside_samples)
+		fprintf(f, "[outside Lua] %lu\n", (unsigned long) lua_profiler.outside_samples);
+
+	if (ferror(f)) {
+		fclose(f);
+		return -EIO;
+	}
+	if (fclose(f) != 0)
+		return -errno;
+	return 0;
+}
+
+void lua_profiler_free(void)
+{
+	lua_profiler_stop();
+	clear_samples();
+}
@@ -0,0 +1,49 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <lua.h>
+
+#define LUA_PROFILER_DEFAULT_INTERVAL 1000 // microseconds
+#define LUA_PROFILER_MAX_DEPTH 64
+
+/*
+ * Samples the Lua stack every interval microseconds of CPU time.
+ * A SIGPROF timer arms a one-shot count hook, so the stack is captured at
+ * the next Lua instruction; time spent in C functions called from Lua is
+ * accounted to their Lua caller. The time spent outside of Lua (between
+ * lua_profiler_enter and lua_profiler_leave, see call_lua_function) is
+ * written as a single "[outside Lua]" stack. With emscripten, a count hook
+ * samples every 1000 instructions instead.
+ *
+ * The hook is set on the main lua_State only: the time spent in coroutines
+ * is accounted to the function which resumed them. A debug hook set by the
+ * game is suspended while a sample is taken and restored afterwards.
+ */
+// discards the samples of the previous run
+void lua_profiler_start(lua_State *L, unsigned int interval);
+void lua_profiler_stop(void);
+bool lua_profiler_is_running(void);
+unsigned long lua_profiler_get_samples(void);
+// writes the samples as folded stacks ("main;update;f 42" lines), for flamegraph.pl
+int lua_profiler_write(const char *filename);
+void lua_profiler_free(void);
+
+// around the calls from the engine to Lua, they can be nested
+void lua_profiler_enter(void);
+void lua_profiler_leave(void);
@@ -22,6 +22,7 @@
 
 #include "engine.h"
 #include "lua_util.h"
+#include "lua_profiler.h"
 #include "util.h"
 #include "livecoding.h"
 #include "log.h"
@@ -49,6 +50,7 @@ void call_lua_function(lua_State *L, int num_args, int num_ret)
 	assert(num_args >= 0);
 	assert(num_ret >= 0);
 
+	lua_profiler_enter();
 #ifdef EMSCRIPTEN
 	lua_call(L, num_args, num_ret);
 #else
@@ -59,7 +61,9 @@ void call_lua_function(lua_State *L, int num_args, int num_ret)
 	if (lua_pcall(L, num_args, num_ret, base)) {
 #ifdef BUILD_LIVECODING
 		if (livecoding_is_running()) {
+			lua_profiler_leave();
 			engine_wait_next_reload();
+			lua_profiler_enter();
 			lua_pop(L, 1);
 		} else
 #endif
@@ -70,5 +74,36 @@ void call_lua_function(lua_State *L, int num_args, int num_ret)
 	}
 	lua_remove(L, base);
 #endif
+	lua_profiler_leave();
 }
 
+int mlua_lean_class_index(lua_State *L)
+{
+	// the custom fields hide the methods, as with the storage tables
+	if (lua_getuservalue(L, 1) == LUA_TTABLE) {
+		lua_pushvalue(L, 2);
+		if (lua_rawget(L, -2) != LUA_TNIL)
+			return 1;
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+
+	lua_getmetatable(L, 1);
+	lua_pushvalue(L, 2);
+	lua_rawget(L, -2);
+	return 1;
+}
+
+int mlua_lean_class_newindex(lua_State *L)
+{
+	if (lua_getuservalue(L, 1) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushvalue(L, -1);
+		lua_setuservalue(L, 1);
+	}
+	lua_pushvalue(L, 2);
+	lua_pushvalue(L, 3);
+	lua_rawset(L, -3);
+	return 0;
+}
@@ -25,6 +25,7 @@ extern "C" {
 #include <lauxlib.h>
 
 #include "log.h"
+#include "object_registry.h"
 
 int traceback(lua_State *L);
 void call_lua_function(lua_State *L, int num_args, int num_ret);
@@ -34,7 +35,7 @@ void call_lua_function(lua_State *L, int num_args, int num_ret);
 #define DECLARE_POP(T, name) \
 	T *pop_ ## name(lua_State *L, int index);
 
-#define IMPLEMENT_PUSH(T, name) \
+#define IMPLEMENT_PUSH(T, name, type) \
 	void push_ ## name(lua_State *L, T *name) \
 	{ \
 		assert(L); \
@@ -61,6 +62,7 @@ void call_lua_function(lua_State *L, int num_args, int num_ret);
 			\
 			lua_pushvalue(L, -1); \
 			name->ref = luaL_ref(L, -3); \
+			object_registry_add(type, name, &name->registry_index); \
 		} \
 		lua_remove(L, lua_gettop(L) - 1); \
 	}
@@ -82,12 +84,58 @@ void call_lua_function(lua_State *L, int num_args, int num_ret);
 		} \
 	}
 
+/*
+ * Lean objects are a single userdata whose metatable is the class, which
+ * must be registered with REGISTER_LEAN_CLASS. There is no storage table:
+ * the fields set from Lua go to the uservalue, created on the first
+ * assignment, and pop only fetches the pointer.
+ */
+#define IMPLEMENT_LEAN_PUSH(T, name, type) \
+	void push_ ## name(lua_State *L, T *name) \
+	{ \
+		assert(L); \
+		assert(name); \
+		lua_getfield(L, LUA_REGISTRYINDEX, "objects"); \
+		if (name->ref) { \
+			lua_rawgeti(L, -1, name->ref); \
+		} else { \
+			T **p = (T **) lua_newuserdata(L, sizeof(T *)); \
+			if (!p) \
+				log_oom_and_exit(); \
+			*p = name; \
+			luaL_setmetatable(L, #name); \
+			\
+			lua_pushvalue(L, -1); \
+			name->ref = luaL_ref(L, -3); \
+			object_registry_add(type, name, &name->registry_index); \
+		} \
+		lua_remove(L, lua_gettop(L) - 1); \
+	}
+
+#define IMPLEMENT_LEAN_POP(T, name) \
+	T *pop_ ## name(lua_State *L, int index) \
+	{ \
+		assert(L); \
+		T **p = (T **) lua_touserdata(L, index); \
+		if (p == NULL) luaL_argerror(L, index, #name" expected"); \
+		assert(p); \
+		return *p; \
+	}
+
+#define IMPLEMENT_LEAN_PUSHPOP(T, name, type) \
+	IMPLEMENT_LEAN_PUSH(T, name, type) \
+	IMPLEMENT_LEAN_POP(T, name)
+
+// __index and __newindex of the lean classes
+int mlua_lean_class_index(lua_State *L);
+int mlua_lean_class_newindex(lua_State *L);
+
 #define DECLARE_PUSHPOP(T, name) \
 	DECLARE_PUSH(T, name) \
 	DECLARE_POP(T, name)
 
-#define IMPLEMENT_PUSHPOP(T, name) \
-	IMPLEMENT_PUSH(T, name) \
+#define IMPLEMENT_PUSHPOP(T, name, type) \
+	IMPLEMENT_PUSH(T, name, type) \
 	IMPLEMENT_POP(T, name)
 
 #define assert_lua_error(L, x, msg) \
@@ -67,6 +67,13 @@ extern "C" {
 		_a > _b ? _a : _b; \
 	})
 
+#define MIN(a,b) \
+	({ \
+		__typeof__ (a) _a = (a); \
+		__typeof__ (b) _b = (b); \
+		_a < _b ? _a : _b; \
+	})
+
 /* Assert with Side Effects */
 #ifdef NDEBUG
 #define assert_se(x) (x)
@@ -14,13 +14,13 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <assert.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #ifdef BUILD_LIVECODING
-#include <assert.h>
 #include <libgen.h>// dirname()
-#include <stdlib.h>
 
 #include "livecoding.h"
 #include "macro.h"
@@ -28,6 +28,7 @@
 
 #include "engine.h"
 #include "dlua.h"
+#include "lua_profiler.h"
 #include "log.h"
 #include "util.h"
 #include "build.h"
@@ -81,6 +82,52 @@ static int start_livecoding(const char *filename)
 }
 #endif
 
+#ifdef BUILD_GRAPHICS
+// parses a list of frames like "1,60,120"
+static int parse_frames(const char *list, unsigned long **frames, size_t *count)
+{
+	unsigned long *array = NULL;
+	size_t size = 0;
+	size_t n = 0;
+	const char *p = list;
+
+	assert(list);
+	assert(frames);
+	assert(count);
+
+	while (*p) {
+		char *end;
+		unsigned long frame = strtoul(p, &end, 10);
+		if (end == p || frame == 0 || (*end != ',' && *end != '\0')) {
+			free(array);
+			return -EINVAL;
+		}
+		XREALLOC(array, size, n + 1);
+		array[n++] = frame;
+		p = *end ? end + 1 : end;
+	}
+
+	*frames = array;
+	*count = n;
+	return 0;
+}
+#endif
+
+/*
+ * Returns the argument of the option argv[*i] and skips it,
+ * or NULL if there is none.
+ */
+static const char *option_argument(int argc, char* argv[], bool is_arg[], int *i)
+{
+	if (*i + 1 >= argc) {
+		fprintf(stderr, "%s: missing argument.\n", argv[*i]);
+		return NULL;
+	}
+	(*i)++;
+	is_arg[*i] = false;
+	return argv[*i];
+}
+
 static void help(void)
 {
 	printf("drystal [OPTIONS] <directory>[/main.lua]\n\n"
@@ -90,6 +137,19 @@ static void help(void)
 #ifdef BUILD_LIVECODING
 	       "    -l --livecoding Enable the livecoding which will reload the lua code when modifications on the files are performed\n"
 #endif
+#ifdef BUILD_GRAPHICS
+	       "    --headless      Render without any window (needs EGL)\n"
+	       "    --dump-frames <n,...>\n"
+	       "                    Save the given frames of the screen as PNG files\n"
+	       "    --dump-dir <directory>\n"
+	       "                    Directory of the dumped frames (default: current directory)\n"
+#endif
+	       "    --frames <n>    Stop after n frames\n"
+	       "    --fixed-dt <s>  Give s seconds as dt to every update, and do not wait between frames\n"
+	       "    --benchmark <file>\n"
+	       "                    Time every frame and write the percentiles to the file in JSON\n"
+	       "    --lua-profile <file>\n"
+	       "                    Sample the Lua stack and write it to the file as folded stacks\n"
 	      );
 }
 
@@ -106,6 +166,15 @@ int main(int argc, char* argv[])
 	int r;
 #ifdef BUILD_LIVECODING
 	bool livecoding = false;
+#endif
+	bool headless = false;
+	unsigned long max_frames = 0;
+	float fixed_dt = 0;
+	const char *benchmark = NULL;
+	const char *lua_profile = NULL;
+#ifdef BUILD_GRAPHICS
+	const char *dump_frames = NULL;
+	const char *dump_directory = ".";
 #endif
 	bool is_arg[argc];
 
@@ -124,6 +193,51 @@ int main(int argc, char* argv[])
 			fprintf(stderr, "Cannot start livecoding: disabled at compilation time.\n");
 			return EXIT_FAILURE;
 #endif
+		} else if (streq(argv[i], "--headless")) {
+#ifdef BUILD_HEADLESS
+			headless = true;
+#else
+			fprintf(stderr, "Cannot start headless: disabled at compilation time.\n");
+			return EXIT_FAILURE;
+#endif
+#ifdef BUILD_GRAPHICS
+		} else if (streq(argv[i], "--dump-frames")) {
+			dump_frames = option_argument(argc, argv, is_arg, &i);
+			if (!dump_frames)
+				return EXIT_FAILURE;
+		} else if (streq(argv[i], "--dump-dir")) {
+			dump_directory = option_argument(argc, argv, is_arg, &i);
+			if (!dump_directory)
+				return EXIT_FAILURE;
+#endif
+		} else if (streq(argv[i], "--frames")) {
+			const char *arg = option_argument(argc, argv, is_arg, &i);
+			char *end;
+			if (!arg)
+				return EXIT_FAILURE;
+			max_frames = strtoul(arg, &end, 10);
+			if (*end || end == arg || max_frames == 0) {
+				fprintf(stderr, "--frames: '%s' is not a positive number.\n", arg);
+				return EXIT_FAILURE;
+			}
+		} else if (streq(argv[i], "--fixed-dt")) {
+			const char *arg = option_argument(argc, argv, is_arg, &i);
+			char *end;
+			if (!arg)
+				return EXIT_FAILURE;
+			fixed_dt = strtof(arg, &end);
+			if (*end || end == arg || !(fixed_dt > 0)) {
+				fprintf(stderr, "--fixed-dt: '%s' is not a positive number of seconds.\n", arg);
+				return EXIT_FAILURE;
+			}
+		} else if (streq(argv[i], "--benchmark")) {
+			benchmark = option_argument(argc, argv, is_arg, &i);
+			if (!benchmark)
+				return EXIT_FAILURE;
+		} else if (streq(argv[i], "--lua-profile")) {
+			lua_profile = option_argument(argc, argv, is_arg, &i);
+			if (!lua_profile)
+				return EXIT_FAILURE;
 		} else if (!filename) {
 			filename = xstrdup(argv[i]);
 		} else {
@@ -144,10 +258,31 @@ int main(int argc, char* argv[])
 		filename = newfilename;
 	}
 
-	r = engine_init(filename, 60);
+	r = engine_init(filename, 60, headless);
 	if (r < 0) {
 		return EXIT_FAILURE;
 	}
+	engine_set_max_frames(max_frames);
+	engine_set_fixed_dt(fixed_dt);
+	if (benchmark)
+		engine_enable_benchmark(benchmark);
+
+#ifdef BUILD_GRAPHICS
+	if (dump_frames) {
+		unsigned long *frames;
+		size_t count;
+
+		r = parse_frames(dump_frames, &frames, &count);
+		if (r < 0) {
+			fprintf(stderr, "--dump-frames: invalid list of frames '%s'.\n", dump_frames);
+			return EXIT_FAILURE;
+		}
+		r = engine_dump_frames(dump_directory, frames, count);
+		if (r < 0) {
+			return EXIT_FAILURE;
+		}
+	}
+#endif
 
 	for (int i = 1; i < argc; i++) {
 		if (is_arg[i]) {
@@ -164,6 +299,9 @@ int main(int argc, char* argv[])
 	}
 #endif
 
+	if (lua_profile)
+		lua_profiler_start(dlua_get_lua_state(), LUA_PROFILER_DEFAULT_INTERVAL);
+
 	engine_load();
 	engine_loop();
 
@@ -171,8 +309,18 @@ int main(int argc, char* argv[])
 	livecoding_quit();
 #endif
 
+	r = engine_write_benchmark();
+	// the script may have stopped the profiler and written its own profile
+	if (lua_profile && lua_profiler_is_running()) {
+		lua_profiler_stop();
+		int k = lua_profiler_write(lua_profile);
+		if (k < 0) {
+			fprintf(stderr, "Cannot write the Lua profile to %s: %s\n", lua_profile, strerror(-k));
+			r = k;
+		}
+	}
 	engine_free();
 	free(filename);
-	return 0;
+	return r < 0 ? EXIT_FAILURE : 0;
 }
 
@@ -66,6 +66,12 @@ extern "C" {
 	PUSH_FUNC("__newindex", name##_class_newindex); \
 	lua_setfield(L, -2, name_in_module);
 
+// for the classes implemented with IMPLEMENT_LEAN_PUSHPOP, see lua_util.h
+#define REGISTER_LEAN_CLASS(name, name_in_module) \
+	PUSH_FUNC("__index", lean_class_index); \
+	PUSH_FUNC("__newindex", lean_class_newindex); \
+	lua_setfield(L, -2, name_in_module);
+
 #define REGISTER_MODULE(name, L) \
 	register_##name(L)
 
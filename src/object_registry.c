@@ -0,0 +1,110 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <stdlib.h>
+
+#include "object_registry.h"
+#include "util.h"
+
+typedef struct RegistryEntry RegistryEntry;
+
+struct RegistryEntry {
+	void *object;
+	size_t *index;
+};
+
+static struct {
+	RegistryEntry *entries;
+	size_t count;
+	size_t size;
+} registries[OBJECT_TYPE_COUNT];
+
+const char *OBJECT_TYPE_NAMES[OBJECT_TYPE_COUNT] = {
+	[OBJECT_SURFACE] = "surface",
+	[OBJECT_BUFFER] = "buffer",
+	[OBJECT_SHADER] = "shader",
+	[OBJECT_ATLAS] = "atlas",
+	[OBJECT_FONT] = "font",
+	[OBJECT_SOUND] = "sound",
+	[OBJECT_MUSIC] = "music",
+	[OBJECT_BODY] = "body",
+	[OBJECT_SHAPE] = "shape",
+	[OBJECT_JOINT] = "joint",
+	[OBJECT_SYSTEM] = "system",
+	[OBJECT_ARRAY] = "array",
+};
+
+void object_registry_add(ObjectType type, void *object, size_t *index)
+{
+	assert(type < OBJECT_TYPE_COUNT);
+	assert(object);
+	assert(index);
+
+	XREALLOC(registries[type].entries, registries[type].size, registries[type].count + 1);
+	registries[type].entries[registries[type].count].object = object;
+	registries[type].entries[registries[type].count].index = index;
+	registries[type].count++;
+	*index = registries[type].count;
+}
+
+void object_registry_remove(ObjectType type, size_t *index)
+{
+	RegistryEntry *entries;
+	size_t last;
+
+	assert(type < OBJECT_TYPE_COUNT);
+	assert(index);
+
+	entries = registries[type].entries;
+
+	if (*index == 0)
+		return;
+	assert(*index <= registries[type].count);
+	assert(entries[*index - 1].index == index);
+
+	// the last entry takes the place of the removed one
+	last = registries[type].count - 1;
+	entries[*index - 1] = entries[last];
+	*entries[*index - 1].index = *index;
+	registries[type].count = last;
+	*index = 0;
+}
+
+size_t object_registry_count(ObjectType type)
+{
+	assert(type < OBJECT_TYPE_COUNT);
+
+	return registries[type].count;
+}
+
+void *object_registry_get(ObjectType type, size_t i)
+{
+	assert(type < OBJECT_TYPE_COUNT);
+	assert(i < registries[type].count);
+
+	return registries[type].entries[i].object;
+}
+
+void object_registry_free(void)
+{
+	for (int i = 0; i < OBJECT_TYPE_COUNT; i++) {
+		free(registries[i].entries);
+		registries[i].entries = NULL;
+		registries[i].count = 0;
+		registries[i].size = 0;
+	}
+}
@@ -0,0 +1,61 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/*
+ * Objects pushed to Lua, by type. The push functions of lua_util.h add the
+ * objects and the __gc functions remove them.
+ */
+enum ObjectType {
+	OBJECT_SURFACE,
+	OBJECT_BUFFER,
+	OBJECT_SHADER,
+	OBJECT_ATLAS,
+	OBJECT_FONT,
+	OBJECT_SOUND,
+	OBJECT_MUSIC,
+	OBJECT_BODY,
+	OBJECT_SHAPE,
+	OBJECT_JOINT,
+	OBJECT_SYSTEM,
+	OBJECT_ARRAY,
+	OBJECT_TYPE_COUNT,
+};
+typedef enum ObjectType ObjectType;
+
+extern const char *OBJECT_TYPE_NAMES[OBJECT_TYPE_COUNT];
+
+/*
+ * *index is the position of the object in the registry, plus one. It is
+ * kept up to date by the registry and is 0 once the object is removed.
+ */
+void object_registry_add(ObjectType type, void *object, size_t *index);
+void object_registry_remove(ObjectType type, size_t *index);
+
+size_t object_registry_count(ObjectType type);
+void *object_registry_get(ObjectType type, size_t i);
+void object_registry_free(void);
+
+#ifdef __cplusplus
+}
+#endif
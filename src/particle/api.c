@@ -20,9 +20,11 @@
 
 BEGIN_MODULE(particle)
 	DECLARE_FUNCTION(new_system)
+	DECLARE_FUNCTION(update_particle_systems)
 
 	BEGIN_CLASS(system)
 		ADD_METHOD(system, emit)
+		ADD_METHOD(system, burst)
 		ADD_METHOD(system, start)
 		ADD_METHOD(system, stop)
 		ADD_METHOD(system, reset)
@@ -36,10 +38,13 @@ BEGIN_MODULE(particle)
 		ADD_METHOD(system, clear_colors)
 		ADD_METHOD(system, clear_alphas)
 		ADD_METHOD(system, set_texture)
+		ADD_METHOD(system, set_seed)
+		ADD_METHOD(system, get_particle_count)
 
 		ADD_GETSET(system, position)
 		ADD_GETSET(system, offset)
 		ADD_GETSET(system, emission_rate)
+		ADD_GETSET(system, max_size)
 
 #define ADD_MINMAX(name) \
 		ADD_GETSET(system, min_##name) \
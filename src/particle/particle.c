@@ -14,33 +14,159 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
  */
-
-#include <math.h>
 #include <assert.h>
+#include <string.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "particle.h"
-#include "system.h"
+#include "log.h"
+
+#define FOREACH_FIELD(DO) \
+	DO(x) DO(y) DO(vel) DO(accel) DO(dir_x) DO(dir_y) \
+	DO(life) DO(lifetime) \
+	DO(sizeseed) DO(rseed) DO(gseed) DO(bseed) DO(alphaseed)
+
+static void resize_field(void **field, size_t size, size_t elem_size)
+{
+	void *q;
+
+	q = realloc(*field, size * elem_size);
+	if (!q)
+		log_oom_and_exit();
+	*field = q;
+}
+
+void particles_resize(Particles *p, size_t size)
+{
+	assert(p);
+	assert(size > 0);
+
+#define RESIZE(field) resize_field((void **) &p->field, size, sizeof(p->field[0]));
+	FOREACH_FIELD(RESIZE)
+#undef RESIZE
+}
+
+void particles_copy(Particles *dst, const Particles *src, size_t used, size_t size)
+{
+	assert(dst);
+	assert(src);
+
+	memset(dst, 0, sizeof(Particles));
+	if (!size)
+		return;
+	particles_resize(dst, size);
+
+#define COPY(field) memcpy(dst->field, src->field, used * sizeof(src->field[0]));
+	FOREACH_FIELD(COPY)
+#undef COPY
+}
+
+void particles_free(Particles *p)
+{
+	if (!p)
+		return;
+
+#define FREE(field) free(p->field); p->field = NULL;
+	FOREACH_FIELD(FREE)
+#undef FREE
+}
+
+void particles_move(Particles *p, size_t to, size_t from)
+{
+	assert(p);
+
+#define MOVE(field) p->field[to] = p->field[from];
+	FOREACH_FIELD(MOVE)
+#undef MOVE
+}
 
-void particle_update(Particle *p, System *s, float dt)
+void particles_set(Particles *dst, size_t to, const Particles *src, size_t from)
+{
+	assert(dst);
+	assert(src);
+
+#define SET(field) dst->field[to] = src->field[from];
+	FOREACH_FIELD(SET)
+#undef SET
+}
+
+void particles_move_range(Particles *p, size_t to, size_t from, size_t count)
 {
 	assert(p);
-	assert(s);
 
-	p->life -= dt;
+	if (!count || to == from)
+		return;
 
-	p->vel += p->accel * dt;
-	p->x += p->vel * cosf(p->dir_angle) * dt;
-	p->y += p->vel * sinf(p->dir_angle) * dt;
+#define MOVE_RANGE(field) memmove(p->field + to, p->field + from, count * sizeof(p->field[0]));
+	FOREACH_FIELD(MOVE_RANGE)
+#undef MOVE_RANGE
+}
 
-	float liferatio = 1 - p->life / p->lifetime;
-	if (liferatio > s->sizes[p->size_state + 1].at && p->size_state < s->cur_size) {
-		p->size_state += 1;
+void particles_remove_front(Particles *p, size_t count, size_t used)
+{
+	assert(p);
+	assert(count <= used);
+
+	particles_move_range(p, 0, count, used - count);
+}
+
+void particles_integrate(Particles *p, size_t start, size_t end, float dt)
+{
+	assert(p);
+
+	size_t i = start;
+
+#if defined(__AVX__)
+	const __m256 dt8 = _mm256_set1_ps(dt);
+	for (; i + 8 <= end; i += 8) {
+		__m256 vel = _mm256_add_ps(_mm256_loadu_ps(p->vel + i),
+		                           _mm256_mul_ps(_mm256_loadu_ps(p->accel + i), dt8));
+		__m256 step = _mm256_mul_ps(vel, dt8);
+		_mm256_storeu_ps(p->vel + i, vel);
+		_mm256_storeu_ps(p->x + i, _mm256_add_ps(_mm256_loadu_ps(p->x + i),
+		                                         _mm256_mul_ps(step, _mm256_loadu_ps(p->dir_x + i))));
+		_mm256_storeu_ps(p->y + i, _mm256_add_ps(_mm256_loadu_ps(p->y + i),
+		                                         _mm256_mul_ps(step, _mm256_loadu_ps(p->dir_y + i))));
+		_mm256_storeu_ps(p->life + i, _mm256_sub_ps(_mm256_loadu_ps(p->life + i), dt8));
 	}
-	if (liferatio > s->colors[p->color_state + 1].at && p->color_state < s->cur_color) {
-		p->color_state += 1;
+#endif
+#if defined(__SSE2__)
+	const __m128 dt4 = _mm_set1_ps(dt);
+	for (; i + 4 <= end; i += 4) {
+		__m128 vel = _mm_add_ps(_mm_loadu_ps(p->vel + i),
+		                        _mm_mul_ps(_mm_loadu_ps(p->accel + i), dt4));
+		__m128 step = _mm_mul_ps(vel, dt4);
+		_mm_storeu_ps(p->vel + i, vel);
+		_mm_storeu_ps(p->x + i, _mm_add_ps(_mm_loadu_ps(p->x + i),
+		                                   _mm_mul_ps(step, _mm_loadu_ps(p->dir_x + i))));
+		_mm_storeu_ps(p->y + i, _mm_add_ps(_mm_loadu_ps(p->y + i),
+		                                   _mm_mul_ps(step, _mm_loadu_ps(p->dir_y + i))));
+		_mm_storeu_ps(p->life + i, _mm_sub_ps(_mm_loadu_ps(p->life + i), dt4));
 	}
-	if (liferatio > s->alphas[p->alpha_state + 1].at && p->alpha_state < s->cur_alpha) {
-		p->alpha_state += 1;
+#elif defined(__ARM_NEON)
+	const float32x4_t dt4 = vdupq_n_f32(dt);
+	for (; i + 4 <= end; i += 4) {
+		float32x4_t vel = vmlaq_f32(vld1q_f32(p->vel + i), vld1q_f32(p->accel + i), dt4);
+		float32x4_t step = vmulq_f32(vel, dt4);
+		vst1q_f32(p->vel + i, vel);
+		vst1q_f32(p->x + i, vmlaq_f32(vld1q_f32(p->x + i), step, vld1q_f32(p->dir_x + i)));
+		vst1q_f32(p->y + i, vmlaq_f32(vld1q_f32(p->y + i), step, vld1q_f32(p->dir_y + i)));
+		vst1q_f32(p->life + i, vsubq_f32(vld1q_f32(p->life + i), dt4));
 	}
-}
+#endif
 
+	for (; i < end; i++) {
+		float vel = p->vel[i] + p->accel[i] * dt;
+		float step = vel * dt;
+		p->vel[i] = vel;
+		p->x[i] += step * p->dir_x[i];
+		p->y[i] += step * p->dir_y[i];
+		p->life[i] -= dt;
+	}
+}
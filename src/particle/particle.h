@@ -16,33 +16,35 @@
  */
 #pragma once
 
-#include <stdbool.h>
+#include <stddef.h>
 
-typedef struct Particle Particle;
+typedef struct Particles Particles;
 
-#include "system.h"
-
-struct Particle {
-	bool dead;
-
-	float x, y;
-	float vel;
-	float accel;
-	float dir_angle;
-
-	float life, lifetime;
-
-	int size_state;
-	float sizeseed;
-
-	int color_state;
-	float rseed;
-	float gseed;
-	float bseed;
-
-	int alpha_state;
-	float alphaseed;
+/*
+ * Particles are stored as a structure of arrays so that the update kernel
+ * can process several of them at once with SIMD instructions.
+ * Only the first 'used' entries (see System) are alive.
+ */
+struct Particles {
+	float *x, *y;
+	float *vel;
+	float *accel;
+	float *dir_x, *dir_y; // unit vector of the emission angle
+
+	float *life, *lifetime;
+
+	float *sizeseed;
+	float *rseed;
+	float *gseed;
+	float *bseed;
+	float *alphaseed;
 };
 
-void particle_update(Particle *p, System *sys, float dt);
-
+void particles_resize(Particles *p, size_t size);
+void particles_copy(Particles *dst, const Particles *src, size_t used, size_t size);
+void particles_free(Particles *p);
+void particles_move(Particles *p, size_t to, size_t from);
+void particles_set(Particles *dst, size_t to, const Particles *src, size_t from);
+void particles_move_range(Particles *p, size_t to, size_t from, size_t count);
+void particles_remove_front(Particles *p, size_t count, size_t used);
+void particles_integrate(Particles *p, size_t start, size_t end, float dt);
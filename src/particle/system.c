@@ -16,15 +16,179 @@
  */
 
 #include <assert.h>
+#include <math.h>
+#include <stdlib.h>
 
 #include "graphics/display.h"
 #include "system.h"
 #include "particle.h"
+#include "job_pool.h"
 #include "util.h"
 #include "log.h"
 
 log_category("system");
 
+// large systems are integrated in several jobs
+#define UPDATE_CHUNK_SIZE 8192
+
+typedef struct UpdateJob UpdateJob;
+typedef struct UpdateBatch UpdateBatch;
+
+struct UpdateJob {
+	System *system;
+	size_t start, end;
+};
+
+struct UpdateBatch {
+	UpdateJob *jobs;
+	System **systems;
+	float dt;
+};
+
+/*
+ * new_system() stores default keyframes without counting them, so that the
+ * first add_* call replaces them. Until two keyframes are added, the
+ * remaining defaults are still read.
+ */
+#define KEYFRAMES_COUNT(cur) MAX((cur), 2)
+
+/*
+ * Sorts the indices of the keyframes by their 'at', so that they can be
+ * added in any order. Insertion sort, there are at most 16 of them.
+ */
+static void sort_keyframes(float *ats, int *order, int count)
+{
+	for (int i = 0; i < count; i++)
+		order[i] = i;
+
+	for (int i = 1; i < count; i++) {
+		float at = ats[i];
+		int index = order[i];
+		int j = i;
+		for (; j > 0 && ats[j - 1] > at; j--) {
+			ats[j] = ats[j - 1];
+			order[j] = order[j - 1];
+		}
+		ats[j] = at;
+		order[j] = index;
+	}
+}
+
+/*
+ * Finds the keyframes around t and how far t is between them, as indices
+ * in the sorted 'ats'. Before the first keyframe and after the last one,
+ * the closest is used.
+ */
+static void find_keyframes(const float *ats, int count, float t, int *a, int *b, float *ratio)
+{
+	assert(count > 0);
+
+	*a = *b = count - 1;
+	*ratio = 0;
+	for (int i = 0; i < count; i++) {
+		if (t <= ats[i]) {
+			*a = i > 0 ? i - 1 : 0;
+			*b = i;
+			if (ats[*b] > ats[*a])
+				*ratio = (t - ats[*a]) / (ats[*b] - ats[*a]);
+			return;
+		}
+	}
+}
+
+static float lerp(float a, float b, float ratio)
+{
+	return a + (b - a) * ratio;
+}
+
+static void system_bake_sizes(System *s)
+{
+	float ats[MAX_SIZES];
+	int order[MAX_SIZES];
+	int count = KEYFRAMES_COUNT(s->cur_size);
+
+	for (int i = 0; i < count; i++)
+		ats[i] = s->sizes[i].at;
+	sort_keyframes(ats, order, count);
+
+	for (int k = 0; k < GRADIENT_SIZE; k++) {
+		GradientRow* row = &s->gradient[k];
+		int a, b;
+		float ratio;
+		find_keyframes(ats, count, (float) k / (GRADIENT_SIZE - 1), &a, &b, &ratio);
+
+		const Size* sA = &s->sizes[order[a]];
+		const Size* sB = &s->sizes[order[b]];
+		row->size = lerp(sA->min, sB->min, ratio);
+		row->size_range = lerp(sA->max - sA->min, sB->max - sB->min, ratio);
+	}
+}
+
+static void system_bake_colors(System *s)
+{
+	float ats[MAX_COLORS];
+	int order[MAX_COLORS];
+	int count = KEYFRAMES_COUNT(s->cur_color);
+
+	for (int i = 0; i < count; i++)
+		ats[i] = s->colors[i].at;
+	sort_keyframes(ats, order, count);
+
+	for (int k = 0; k < GRADIENT_SIZE; k++) {
+		GradientRow* row = &s->gradient[k];
+		int a, b;
+		float ratio;
+		find_keyframes(ats, count, (float) k / (GRADIENT_SIZE - 1), &a, &b, &ratio);
+
+		const Color* cA = &s->colors[order[a]];
+		const Color* cB = &s->colors[order[b]];
+		row->r = lerp(cA->min_r, cB->min_r, ratio);
+		row->r_range = lerp(cA->max_r - cA->min_r, cB->max_r - cB->min_r, ratio);
+		row->g = lerp(cA->min_g, cB->min_g, ratio);
+		row->g_range = lerp(cA->max_g - cA->min_g, cB->max_g - cB->min_g, ratio);
+		row->b = lerp(cA->min_b, cB->min_b, ratio);
+		row->b_range = lerp(cA->max_b - cA->min_b, cB->max_b - cB->min_b, ratio);
+	}
+}
+
+static void system_bake_alphas(System *s)
+{
+	float ats[MAX_ALPHAS];
+	int order[MAX_ALPHAS];
+	int count = KEYFRAMES_COUNT(s->cur_alpha);
+
+	for (int i = 0; i < count; i++)
+		ats[i] = s->alphas[i].at;
+	sort_keyframes(ats, order, count);
+
+	for (int k = 0; k < GRADIENT_SIZE; k++) {
+		GradientRow* row = &s->gradient[k];
+		if (!s->cur_alpha) {
+			row->alpha = 255;
+			row->alpha_range = 0;
+			continue;
+		}
+
+		int a, b;
+		float ratio;
+		find_keyframes(ats, count, (float) k / (GRADIENT_SIZE - 1), &a, &b, &ratio);
+
+		const Alpha* aA = &s->alphas[order[a]];
+		const Alpha* aB = &s->alphas[order[b]];
+		row->alpha = lerp(aA->min, aB->min, ratio);
+		row->alpha_range = lerp(aA->max - aA->min, aB->max - aB->min, ratio);
+	}
+}
+
+void system_bake_gradient(System *s)
+{
+	assert(s);
+
+	system_bake_sizes(s);
+	system_bake_colors(s);
+	system_bake_alphas(s);
+}
+
 System *system_new(float x, float y, size_t size)
 {
 	System *s;
@@ -34,10 +198,12 @@ System *system_new(float x, float y, size_t size)
 	s->x = x;
 	s->y = y;
 	s->size = size;
+	system_set_seed(s, rand());
 
-	s->particles = new(Particle, s->size);
-	for (size_t i = 0; i < s->size; i++)
-		s->particles[i].dead = true;
+	if (s->size)
+		particles_resize(&s->particles, s->size);
+
+	system_bake_gradient(s);
 
 	return s;
 }
@@ -47,8 +213,8 @@ System *system_clone(System* s)
 	System *new = new(System, 1);
 	memcpy(new, s, sizeof(System));
 
-	new->particles = new(Particle, new->size);
-	memcpy(new->particles, s->particles, s->size * sizeof(Particle));
+	particles_copy(&new->particles, &s->particles, s->used, s->size);
+	system_set_seed(new, rand());
 	new->ref = 0;
 
 	return new;
@@ -59,7 +225,7 @@ void system_free(System *s)
 	if (!s)
 		return;
 
-	free(s->particles);
+	particles_free(&s->particles);
 	free(s);
 }
 
@@ -81,11 +247,105 @@ void system_reset(System *s)
 {
 	assert(s);
 
-	for (size_t i = 0; i < s->used; i++)
-		s->particles[i].dead = true;
 	s->used = 0;
 }
 
+// same sprite size as display_draw_point_tex()
+#define SPRITE_SIZE 64
+
+static void system_particle_appearance(const System *s, size_t i, float *size, unsigned char color[4])
+{
+	const Particles* p = &s->particles;
+	float liferatio = 1 - p->life[i] / p->lifetime[i];
+
+	int index = liferatio * (GRADIENT_SIZE - 1) + 0.5f;
+	if (index < 0)
+		index = 0;
+	else if (index >= GRADIENT_SIZE)
+		index = GRADIENT_SIZE - 1;
+	const GradientRow* row = &s->gradient[index];
+
+	*size = row->size + p->sizeseed[i] * row->size_range;
+	color[0] = row->r + p->rseed[i] * row->r_range;
+	color[1] = row->g + p->gseed[i] * row->g_range;
+	color[2] = row->b + p->bseed[i] * row->b_range;
+	color[3] = row->alpha + p->sizeseed[i] * row->alpha_range;
+}
+
+/*
+ * Writes the quads of the particles directly in the buffer,
+ * instead of going through display_draw_point() for each of them.
+ */
+static void system_draw_to_buffer(System *s, Buffer *b, float dx, float dy)
+{
+	const Particles* p = &s->particles;
+	float u1 = s->sprite_x;
+	float v1 = s->sprite_y;
+	float u2 = u1 + SPRITE_SIZE;
+	float v2 = v1 + SPRITE_SIZE;
+	GLubyte texture = 0;
+
+	if (s->texture)
+		buffer_check_use_texture(b);
+	else
+		buffer_check_not_use_texture(b);
+
+	if (s->texture && buffer_batches_textures(b)) {
+		// the textures have different sizes, normalize now
+		u1 /= s->texture->texw;
+		u2 /= s->texture->texw;
+		v1 /= s->texture->texh;
+		v2 /= s->texture->texh;
+	}
+
+	size_t i = s->used;
+	while (i > 0) {
+		unsigned int n = buffer_check_room(b, MIN(i, (size_t) BUFFER_MAX_QUADS_PER_DRAW));
+		if (s->texture) {
+			buffer_check_texture(b, s->texture);
+			texture = b->texture;
+		}
+
+		Vertex* v = buffer_reserved_vertices(b);
+		for (unsigned int k = 0; k < n; k++, v += BUFFER_VERTICES_PER_QUAD) {
+			float size;
+			unsigned char color[4];
+
+			i -= 1;
+			system_particle_appearance(s, i, &size, color);
+
+			float hs = size / 2;
+			float x = dx + p->x[i];
+			float y = dy + p->y[i];
+			v[0].x = x - hs;
+			v[0].y = y - hs;
+			v[0].u = u1;
+			v[0].v = v1;
+			v[1].x = x + hs;
+			v[1].y = y - hs;
+			v[1].u = u2;
+			v[1].v = v1;
+			v[2].x = x + hs;
+			v[2].y = y + hs;
+			v[2].u = u2;
+			v[2].v = v2;
+			v[3].x = x - hs;
+			v[3].y = y + hs;
+			v[3].u = u1;
+			v[3].v = v2;
+			for (int j = 0; j < BUFFER_VERTICES_PER_QUAD; j++) {
+				v[j].r = color[0];
+				v[j].g = color[1];
+				v[j].b = color[2];
+				v[j].a = color[3];
+				v[j].blend = b->blend;
+				v[j].texture = texture;
+			}
+		}
+		buffer_commit_quads(b, n);
+	}
+}
+
 void system_draw(System *s, float dx, float dy)
 {
 	assert(s);
@@ -98,126 +358,255 @@ void system_draw(System *s, float dx, float dy)
 		display_draw_from(s->texture);
 	}
 
-	for (int i = s->used - 1; i >= 0; i--) {
-		Particle* p = &s->particles[i];
+	Buffer* buffer = display_get_current_buffer();
+	if (display_is_debug() && !buffer->user_buffer) {
+		// go through the display to get the outlines
+		const Particles* p = &s->particles;
+		for (size_t i = s->used; i-- > 0;) {
+			float size;
+			unsigned char color[4];
+			system_particle_appearance(s, i, &size, color);
+
+			display_set_color(color[0], color[1], color[2]);
+			display_set_alpha(color[3]);
+			if (s->texture)
+				display_draw_point_tex(s->sprite_x, s->sprite_y, dx + p->x[i], dy + p->y[i], size);
+			else
+				display_draw_point(dx + p->x[i], dy + p->y[i], size);
+		}
+	} else {
+		system_draw_to_buffer(s, buffer, dx, dy);
+	}
+
+	display_draw_from(old_surface);
+}
+
+static void system_reserve(System *s, size_t need)
+{
+	if (need <= s->size)
+		return;
 
-		float liferatio = 1 - p->life / p->lifetime;
+	// grow geometrically, as bursts would otherwise realloc every time
+	size_t size = MAX(MAX(s->size * 2, need), 32u);
+	if (s->max_size)
+		size = MIN(size, MAX(s->max_size, need));
+	s->size = size;
+	particles_resize(&s->particles, s->size);
+	log_debug("realloc upto %zu particles", s->size);
+}
 
-		float _size;
-		{
-			Size sA = s->sizes[p->size_state];
-			Size sB = s->sizes[p->size_state + 1];
+static void system_init_particle(System *s, size_t i)
+{
+	Particles* p = &s->particles;
+
+	p->x[i] = s->x + RAND(s, -s->offx, s->offx);
+	p->y[i] = s->y + RAND(s, -s->offy, s->offy);
+	p->sizeseed[i] = system_random(s);
+	p->rseed[i] = system_random(s);
+	p->gseed[i] = system_random(s);
+	p->bseed[i] = system_random(s);
+	p->alphaseed[i] = system_random(s);
+
+	float dir_angle = RAND(s, s->min_direction, s->max_direction);
+	p->dir_x[i] = cosf(dir_angle);
+	p->dir_y[i] = sinf(dir_angle);
+	p->accel[i] = RAND(s, s->min_initial_acceleration, s->max_initial_acceleration);
+	p->vel[i] = RAND(s, s->min_initial_velocity, s->max_initial_velocity);
+
+	p->lifetime[i] = RAND(s, s->min_lifetime, s->max_lifetime);
+	p->life[i] = p->lifetime[i];
+}
 
-			float ratio = (liferatio - sA.at) / (sB.at - sA.at);
+/*
+ * Emits n particles at once. Past max_size, the oldest particles are
+ * replaced if recycle_oldest is set, otherwise the extra ones are dropped.
+ * With recycle_oldest, particles are kept in emission order, so the oldest
+ * are at the front.
+ */
+void system_burst(System *s, size_t n)
+{
+	assert(s);
 
-			float sizeA = p->sizeseed * (sA.max - sA.min) + sA.min;
-			float sizeB = p->sizeseed * (sB.max - sB.min) + sB.min;
-			_size = sizeA * (1 - ratio) + sizeB * ratio;
+	if (s->max_size && s->used + n > s->max_size) {
+		if (s->recycle_oldest) {
+			n = MIN(n, s->max_size);
+			size_t oldest = s->used + n - s->max_size;
+			particles_remove_front(&s->particles, oldest, s->used);
+			s->used -= oldest;
+		} else {
+			n = s->used < s->max_size ? s->max_size - s->used : 0;
 		}
+	}
+	if (!n)
+		return;
 
-		unsigned char r, g, b;
-		{
-			Color cA = s->colors[p->color_state];
-			Color cB = s->colors[p->color_state + 1];
+	system_reserve(s, s->used + n);
+	for (size_t i = s->used; i < s->used + n; i++)
+		system_init_particle(s, i);
+	s->used += n;
+}
 
-			float ratio = (liferatio - cA.at) / (cB.at - cA.at);
+void system_emit(System *s)
+{
+	system_burst(s, 1);
+}
 
-			unsigned char colrA = p->rseed * (cA.max_r - cA.min_r) + cA.min_r;
-			unsigned char colrB = p->rseed * (cB.max_r - cB.min_r) + cB.min_r;
-			r = colrA * (1 - ratio) + colrB * ratio;
+typedef struct ParticleAge ParticleAge;
 
-			unsigned char colgA = p->gseed * (cA.max_g - cA.min_g) + cA.min_g;
-			unsigned char colgB = p->gseed * (cB.max_g - cB.min_g) + cB.min_g;
-			g = colgA * (1 - ratio) + colgB * ratio;
+struct ParticleAge {
+	float age;
+	size_t index;
+};
 
-			unsigned char colbA = p->bseed * (cA.max_b - cA.min_b) + cA.min_b;
-			unsigned char colbB = p->bseed * (cB.max_b - cB.min_b) + cB.min_b;
-			b = colbA * (1 - ratio) + colbB * ratio;
-		}
+static int compare_ages(const void *a, const void *b)
+{
+	const ParticleAge *x = a;
+	const ParticleAge *y = b;
 
-		unsigned char alpha = 255;
-		if (s->cur_alpha) {
-			Alpha aA = s->alphas[p->alpha_state];
-			Alpha aB = s->alphas[p->alpha_state + 1];
+	// oldest first
+	return (x->age < y->age) - (x->age > y->age);
+}
 
-			float ratio = (liferatio - aA.at) / (aB.at - aA.at);
+/*
+ * The dead particles are swap-removed unless the oldest are recycled, so
+ * the emission order is restored from the ages when recycling is enabled.
+ */
+static void system_sort_by_age(System *s)
+{
+	Particles *p = &s->particles;
+	Particles sorted;
+	ParticleAge *ages;
 
-			float alphaA = p->sizeseed * (aA.max - aA.min) + aA.min;
-			float alphaB = p->sizeseed * (aB.max - aB.min) + aB.min;
-			alpha = alphaA * (1 - ratio) + alphaB * ratio;
-		}
+	if (s->used < 2)
+		return;
 
-		display_set_color(r, g, b);
-		display_set_alpha(alpha);
-		if (s->texture)
-			display_draw_point_tex(s->sprite_x, s->sprite_y, dx + p->x, dy + p->y, _size);
-		else
-			display_draw_point(dx + p->x, dy + p->y, _size);
+	ages = new(ParticleAge, s->used);
+	for (size_t i = 0; i < s->used; i++) {
+		ages[i].age = p->lifetime[i] - p->life[i];
+		ages[i].index = i;
 	}
+	qsort(ages, s->used, sizeof(ParticleAge), compare_ages);
 
-	display_draw_from(old_surface);
+	particles_copy(&sorted, p, s->used, s->size);
+	for (size_t i = 0; i < s->used; i++)
+		particles_set(p, i, &sorted, ages[i].index);
+	particles_free(&sorted);
+	free(ages);
 }
 
-void system_emit(System *s)
+void system_set_max_size(System *s, size_t max_size, bool recycle_oldest)
 {
 	assert(s);
 
-	if (s->used == s->size) {
-		XREALLOC(s->particles, s->size, s->size + 1);
-		log_debug("realloc upto %zu particles", s->size);
+	bool was_ordered = s->max_size && s->recycle_oldest;
+	s->max_size = max_size;
+	s->recycle_oldest = recycle_oldest;
+	if (max_size && recycle_oldest && !was_ordered)
+		system_sort_by_age(s);
+}
+
+// removes the dead particles and emits the new ones
+static void system_finish_update(System *s, float dt)
+{
+	Particles* p = &s->particles;
+
+	if (s->max_size && s->recycle_oldest) {
+		// keep the emission order for system_burst(), moving the runs of live particles at once
+		size_t alive = 0;
+		size_t i = 0;
+		while (i < s->used) {
+			while (i < s->used && p->life[i] <= 0)
+				i++;
+			size_t start = i;
+			while (i < s->used && p->life[i] > 0)
+				i++;
+			particles_move_range(p, alive, start, i - start);
+			alive += i - start;
+		}
+		s->used = alive;
+	} else {
+		for (size_t i = 0; i < s->used; i++) {
+			if (p->life[i] <= 0) {
+				particles_move(p, i, s->used - 1);
+				s->used -= 1;
+				i -= 1;
+			}
+		}
 	}
 
-	Particle* p = &s->particles[s->used];
-	p->x = s->x + RAND(-s->offx, s->offx);
-	p->y = s->y + RAND(-s->offy, s->offy);
-	p->sizeseed = (float) rand() / RAND_MAX;
-	p->rseed = (float) rand() / RAND_MAX;
-	p->gseed = (float) rand() / RAND_MAX;
-	p->bseed = (float) rand() / RAND_MAX;
-	p->alphaseed = (float) rand() / RAND_MAX;
-	p->color_state = 0;
-	p->size_state = 0;
-	p->alpha_state = 0;
+	if (s->running && s->emission_rate > 0) {
+		s->emit_counter += dt;
+		size_t n = s->emit_counter * s->emission_rate;
+		if (n) {
+			s->emit_counter -= n / s->emission_rate;
+			system_burst(s, n);
+		}
+	}
+}
 
-	p->dir_angle = RAND(s->min_direction, s->max_direction);
-	p->accel = RAND(s->min_initial_acceleration, s->max_initial_acceleration);
-	p->vel = RAND(s->min_initial_velocity, s->max_initial_velocity);
+void system_update(System *s, float dt)
+{
+	assert(s);
 
-	p->lifetime = RAND(s->min_lifetime, s->max_lifetime);
-	p->life = p->lifetime;
+	particles_integrate(&s->particles, 0, s->used, dt);
+	system_finish_update(s, dt);
+}
 
-	p->dead = false;
+static void integrate_job(void *data, size_t index)
+{
+	const UpdateBatch *batch = data;
+	const UpdateJob *job = &batch->jobs[index];
 
-	s->used += 1;
+	particles_integrate(&job->system->particles, job->start, job->end, batch->dt);
 }
 
-void system_update(System *s, float dt)
+static void finish_job(void *data, size_t index)
 {
-	assert(s);
+	const UpdateBatch *batch = data;
 
-	for (size_t i = 0; i < s->used; i++) {
-		Particle* p = &s->particles[i];
-		particle_update(p, s, dt);
-	}
+	system_finish_update(batch->systems[index], batch->dt);
+}
 
-	for (size_t i = 0; i < s->used; i++) {
-		Particle* p = &s->particles[i];
-		if (p->life <= 0) {
-			p->dead = true;
-			s->particles[i] = s->particles[s->used - 1];
-			s->used -= 1;
-			i -= 1;
-		}
-	}
+/*
+ * Same as calling system_update() on each system, but the work is spread
+ * over the job pool. A system must not appear twice in the list.
+ */
+void system_update_many(System **systems, size_t count, float dt)
+{
+	UpdateBatch batch;
+	size_t jobs = 0;
 
-	if (s->running) {
-		float rate = 1.0f / s->emission_rate;
-		s->emit_counter += dt;
-		if (s->emit_counter > rate) {
-			system_emit(s);
-			s->emit_counter -= rate;
+	assert(systems || !count);
+
+	for (size_t i = 0; i < count; i++)
+		jobs += (systems[i]->used + UPDATE_CHUNK_SIZE - 1) / UPDATE_CHUNK_SIZE;
+
+	batch.jobs = jobs ? new(UpdateJob, jobs) : NULL;
+	batch.systems = systems;
+	batch.dt = dt;
+
+	jobs = 0;
+	for (size_t i = 0; i < count; i++) {
+		for (size_t start = 0; start < systems[i]->used; start += UPDATE_CHUNK_SIZE) {
+			UpdateJob *job = &batch.jobs[jobs++];
+			job->system = systems[i];
+			job->start = start;
+			job->end = MIN(start + UPDATE_CHUNK_SIZE, systems[i]->used);
 		}
 	}
+
+	job_pool_run(integrate_job, &batch, jobs);
+	job_pool_run(finish_job, &batch, count);
+
+	free(batch.jobs);
+}
+
+void system_set_seed(System *s, uint32_t seed)
+{
+	assert(s);
+
+	// xorshift never leaves zero
+	s->random_state = seed ? seed : 0x9e3779b9;
 }
 
 void system_add_size(System *s, float at, float min, float max)
@@ -229,6 +618,8 @@ void system_add_size(System *s, float at, float min, float max)
 	s->sizes[s->cur_size].min = min;
 	s->sizes[s->cur_size].max = max;
 	s->cur_size += 1;
+
+	system_bake_sizes(s);
 }
 
 void system_add_color(System *s, float at, unsigned char min_r, unsigned char max_r, unsigned char min_g, unsigned char max_g, unsigned char min_b, unsigned char max_b)
@@ -244,6 +635,8 @@ void system_add_color(System *s, float at, unsigned char min_r, unsigned char ma
 	s->colors[s->cur_color].min_b = min_b;
 	s->colors[s->cur_color].max_b = max_b;
 	s->cur_color += 1;
+
+	system_bake_colors(s);
 }
 
 void system_add_alpha(System *s, float at, float min, float max)
@@ -255,6 +648,8 @@ void system_add_alpha(System *s, float at, float min, float max)
 	s->alphas[s->cur_alpha].min = min;
 	s->alphas[s->cur_alpha].max = max;
 	s->cur_alpha += 1;
+
+	system_bake_alphas(s);
 }
 
 void system_clear_sizes(System *s)
@@ -262,6 +657,7 @@ void system_clear_sizes(System *s)
 	assert(s);
 
 	s->cur_size = 0;
+	system_bake_sizes(s);
 }
 
 void system_clear_colors(System *s)
@@ -269,6 +665,7 @@ void system_clear_colors(System *s)
 	assert(s);
 
 	s->cur_color = 0;
+	system_bake_colors(s);
 }
 
 void system_clear_alphas(System *s)
@@ -276,6 +673,7 @@ void system_clear_alphas(System *s)
 	assert(s);
 
 	s->cur_alpha = 0;
+	system_bake_alphas(s);
 }
 
 void system_set_texture(System* s, Surface* tex, float x, float y)
@@ -16,17 +16,19 @@
  */
 #pragma once
 
-#include <stdlib.h> // random
+#include <stdint.h>
+#include <stdlib.h> // rand
 
 typedef struct Color Color;
 typedef struct Size Size;
 typedef struct Alpha Alpha;
+typedef struct GradientRow GradientRow;
 typedef struct System System;
 
 #include "graphics/surface.h"
 #include "particle.h"
 
-#define RAND(a, b) (((float) rand()/RAND_MAX) * ((b) - (a)) + (a))
+#define RAND(s, a, b) (system_random(s) * ((b) - (a)) + (a))
 
 #define MAX_COLORS 16
 struct Color {
@@ -48,8 +50,22 @@ struct Alpha {
 	float min, max;
 };
 
+/*
+ * Sizes, colors and alphas keyframes baked at a fixed resolution over the
+ * lifetime of the particles. A particle picks the row of its life ratio
+ * and takes min + seed * range for each channel.
+ */
+#define GRADIENT_SIZE 256
+struct GradientRow {
+	float size, size_range;
+	float r, r_range;
+	float g, g_range;
+	float b, b_range;
+	float alpha, alpha_range;
+};
+
 struct System {
-	Particle* particles;
+	Particles particles;
 
 	int cur_size;
 	Size sizes[MAX_SIZES];
@@ -60,11 +76,15 @@ struct System {
 	int cur_alpha;
 	Alpha alphas[MAX_ALPHAS];
 
+	GradientRow gradient[GRADIENT_SIZE];
+
 	Surface* texture;
 	bool running;
 
 	size_t size;
 	size_t used;
+	size_t max_size; // 0 if the particles can grow without limit
+	bool recycle_oldest;
 
 	float x, y;
 	float offx, offy;
@@ -78,10 +98,16 @@ struct System {
 	float emission_rate;
 	float emit_counter;
 
+	// xorshift32 state, each system draws its own numbers
+	// so that systems can be updated concurrently
+	uint32_t random_state;
+	bool updating; // see system_update_many()
+
 	int sprite_x;
 	int sprite_y;
 
 	int ref;
+	size_t registry_index; // see object_registry.h
 };
 
 System *system_new(float x, float y, size_t size);
@@ -93,12 +119,27 @@ void system_stop(System *s);
 void system_reset(System *s);
 void system_draw(System *s, float dx, float dy);
 void system_emit(System *s);
+void system_burst(System *s, size_t n);
+void system_set_max_size(System *s, size_t max_size, bool recycle_oldest);
 void system_update(System *s, float dt);
+void system_update_many(System **systems, size_t count, float dt);
+void system_set_seed(System *s, uint32_t seed);
 void system_add_size(System *s, float at, float min, float max);
 void system_add_color(System *s, float at, unsigned char min_r, unsigned char max_r, unsigned char min_g, unsigned char max_g, unsigned char min_b, unsigned char max_b);
 void system_add_alpha(System *s, float at, float min, float max);
 void system_clear_sizes(System *s);
 void system_clear_colors(System *s);
 void system_clear_alphas(System *s);
+void system_bake_gradient(System *s);
 void system_set_texture(System* s, Surface* tex, float x, float y);
 
+// random float in [0, 1)
+static inline float system_random(System *s)
+{
+	uint32_t x = s->random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	s->random_state = x;
+	return (x >> 8) * (1.f / (1 << 24));
+}
@@ -24,7 +24,7 @@
 #include "lua_util.h"
 #include "graphics/display_bind.h" // pop_surface
 
-IMPLEMENT_PUSHPOP(System, system)
+IMPLEMENT_PUSHPOP(System, system, OBJECT_SYSTEM)
 
 int mlua_new_system(lua_State* L)
 {
@@ -39,6 +39,7 @@ int mlua_new_system(lua_State* L)
 	system->min_direction = 0;
 	system->max_direction = M_PI * 2;
 
+	// the defaults are not counted, the first keyframes added replace them
 	system->sizes[0].at = 0;
 	system->sizes[0].min = 5;
 	system->sizes[0].max = 5;
@@ -48,25 +49,25 @@ int mlua_new_system(lua_State* L)
 	system->min_lifetime = 3;
 	system->max_lifetime = 10;
 
-	system->min_initial_acceleration = RAND(-10, 10);
+	system->min_initial_acceleration = RAND(system, -10, 10);
 	system->max_initial_acceleration = system->min_initial_acceleration + 3;
-	system->min_initial_velocity = RAND(10, 100);
-	system->max_initial_velocity = system->min_initial_velocity + RAND(10, 100);
+	system->min_initial_velocity = RAND(system, 10, 100);
+	system->max_initial_velocity = system->min_initial_velocity + RAND(system, 10, 100);
 
 	system->colors[0].at = 0;
-	system->colors[0].min_r = RAND(0, 125);
-	system->colors[0].max_r = system->colors[0].min_r + RAND(0, 50);
-	system->colors[0].min_g = RAND(0, 125);
-	system->colors[0].max_g = system->colors[0].min_g + RAND(0, 50);
-	system->colors[0].min_b = RAND(0, 125);
-	system->colors[0].max_b = system->colors[0].min_b + RAND(0, 50);
+	system->colors[0].min_r = RAND(system, 0, 125);
+	system->colors[0].max_r = system->colors[0].min_r + RAND(system, 0, 50);
+	system->colors[0].min_g = RAND(system, 0, 125);
+	system->colors[0].max_g = system->colors[0].min_g + RAND(system, 0, 50);
+	system->colors[0].min_b = RAND(system, 0, 125);
+	system->colors[0].max_b = system->colors[0].min_b + RAND(system, 0, 50);
 	system->colors[1].at = 1;
-	system->colors[1].min_r = RAND(0, 125);
-	system->colors[1].max_r = system->colors[0].min_r + RAND(0, 50);
-	system->colors[1].min_g = RAND(0, 125);
-	system->colors[1].max_g = system->colors[0].min_g + RAND(0, 50);
-	system->colors[1].min_b = RAND(0, 125);
-	system->colors[1].max_b = system->colors[0].min_b + RAND(0, 50);
+	system->colors[1].min_r = RAND(system, 0, 125);
+	system->colors[1].max_r = system->colors[0].min_r + RAND(system, 0, 50);
+	system->colors[1].min_g = RAND(system, 0, 125);
+	system->colors[1].max_g = system->colors[0].min_g + RAND(system, 0, 50);
+	system->colors[1].min_b = RAND(system, 0, 125);
+	system->colors[1].max_b = system->colors[0].min_b + RAND(system, 0, 50);
 
 	system->alphas[0].at = 0;
 	system->alphas[0].min = 255;
@@ -74,8 +75,9 @@ int mlua_new_system(lua_State* L)
 	system->alphas[1].at = 1;
 	system->alphas[1].min = 255;
 	system->alphas[1].max = 255;
+	system_bake_gradient(system);
 
-	system->emission_rate = RAND(1, 19);
+	system->emission_rate = RAND(system, 1, 19);
 	system->offx = 0.f;
 	system->offy = 0.f;
 
@@ -164,15 +166,101 @@ int mlua_update_system(lua_State* L)
 	return 0;
 }
 
+int mlua_update_particle_systems(lua_State* L)
+{
+	assert(L);
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	lua_Number dt = luaL_checknumber(L, 2);
+	size_t count = lua_rawlen(L, 1);
+	if (!count)
+		return 0;
+
+	// as a userdata, the array is collected even if an error is raised
+	System** systems = (System**) lua_newuserdata(L, count * sizeof(System*));
+	for (size_t i = 0; i < count; i++) {
+		lua_rawgeti(L, 1, i + 1);
+		systems[i] = pop_system(L, -1);
+		lua_pop(L, 1);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (systems[i]->updating) {
+			for (size_t j = 0; j < i; j++)
+				systems[j]->updating = false;
+			return luaL_error(L, "update_particle_systems: system %d appears twice in the list", (int) i + 1);
+		}
+		systems[i]->updating = true;
+	}
+
+	system_update_many(systems, count, dt);
+
+	for (size_t i = 0; i < count; i++)
+		systems[i]->updating = false;
+	return 0;
+}
+
+int mlua_set_seed_system(lua_State* L)
+{
+	assert(L);
+
+	System* system = pop_system(L, 1);
+	lua_Integer seed = luaL_checkinteger(L, 2);
+	system_set_seed(system, seed);
+	return 0;
+}
+
 int mlua_emit_system(lua_State* L)
 {
 	System* system = pop_system(L, 1);
-	int n = luaL_optinteger(L, 2, 1);
-	while (n--)
-		system_emit(system);
+	lua_Integer n = luaL_optinteger(L, 2, 1);
+	if (n > 0)
+		system_burst(system, n);
 	return 0;
 }
 
+int mlua_burst_system(lua_State* L)
+{
+	assert(L);
+
+	System* system = pop_system(L, 1);
+	lua_Integer n = luaL_checkinteger(L, 2);
+	assert_lua_error(L, n >= 0, "burst: the number of particles must be positive");
+	system_burst(system, n);
+	return 0;
+}
+
+int mlua_set_max_size_system(lua_State* L)
+{
+	assert(L);
+
+	System* system = pop_system(L, 1);
+	lua_Integer max_size = luaL_optinteger(L, 2, 0);
+	bool recycle_oldest = lua_toboolean(L, 3);
+	assert_lua_error(L, max_size >= 0, "set_max_size: the size must be positive");
+	system_set_max_size(system, max_size, recycle_oldest);
+	return 0;
+}
+
+int mlua_get_max_size_system(lua_State* L)
+{
+	assert(L);
+
+	System* system = pop_system(L, 1);
+	lua_pushinteger(L, system->max_size);
+	lua_pushboolean(L, system->recycle_oldest);
+	return 2;
+}
+
+int mlua_get_particle_count_system(lua_State* L)
+{
+	assert(L);
+
+	System* system = pop_system(L, 1);
+	lua_pushinteger(L, system->used);
+	return 1;
+}
+
 #define ACTION(action) \
 	int mlua_##action##_system(lua_State* L) \
 	{ \
@@ -297,6 +385,7 @@ int mlua_free_system(lua_State* L)
 	assert(L);
 
 	System* system = pop_system(L, 1);
+	object_registry_remove(OBJECT_SYSTEM, &system->registry_index);
 	system_free(system);
 	return 0;
 }
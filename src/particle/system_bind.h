@@ -29,6 +29,12 @@ int mlua_get_position_system(lua_State* L);
 int mlua_set_offset_system(lua_State* L);
 int mlua_get_offset_system(lua_State* L);
 int mlua_update_system(lua_State* L);
+int mlua_update_particle_systems(lua_State* L);
+int mlua_set_seed_system(lua_State* L);
+int mlua_burst_system(lua_State* L);
+int mlua_set_max_size_system(lua_State* L);
+int mlua_get_max_size_system(lua_State* L);
+int mlua_get_particle_count_system(lua_State* L);
 int mlua_draw_system(lua_State* L);
 int mlua_add_size_system(lua_State* L);
 int mlua_add_color_system(lua_State* L);
@@ -60,7 +60,7 @@ BEGIN_MODULE(physics)
 		ADD_METHOD(body, dump)
 		ADD_METHOD(body, destroy)
 		ADD_GC(free_body)
-	REGISTER_CLASS(body, "Body")
+	REGISTER_LEAN_CLASS(body, "Body")
 
 	BEGIN_CLASS(shape)
 		ADD_GETSET(shape, density)
@@ -68,33 +68,33 @@ BEGIN_MODULE(physics)
 		ADD_GETSET(shape, friction)
 		ADD_METHOD(shape, set_sensor)
 		ADD_GC(gc_shape)
-	REGISTER_CLASS(shape, "Shape")
+	REGISTER_LEAN_CLASS(shape, "Shape")
 
 	BEGIN_CLASS(mouse_joint)
 		ADD_METHOD(joint, destroy)
 		ADD_METHOD(mouse_joint, set_target)
 		ADD_GC(free_joint)
-	REGISTER_CLASS(mouse_joint, "MouseJoint")
+	REGISTER_LEAN_CLASS(mouse_joint, "MouseJoint")
 
 	BEGIN_CLASS(distance_joint)
 		ADD_METHOD(joint, destroy)
 		ADD_METHOD(distance_joint, set_length)
 		ADD_METHOD(distance_joint, set_frequency)
 		ADD_GC(free_joint)
-	REGISTER_CLASS(distance_joint, "DistanceJoint")
+	REGISTER_LEAN_CLASS(distance_joint, "DistanceJoint")
 
 	BEGIN_CLASS(rope_joint)
 		ADD_METHOD(joint, destroy)
 		ADD_METHOD(rope_joint, set_max_length)
 		ADD_GC(free_joint)
-	REGISTER_CLASS(rope_joint, "RopeJoint")
+	REGISTER_LEAN_CLASS(rope_joint, "RopeJoint")
 
 	BEGIN_CLASS(revolute_joint)
 		ADD_METHOD(joint, destroy)
 		ADD_METHOD(revolute_joint, set_angle_limits)
 		ADD_METHOD(revolute_joint, set_motor_speed)
 		ADD_GC(free_joint)
-	REGISTER_CLASS(revolute_joint, "RevoluteJoint")
+	REGISTER_LEAN_CLASS(revolute_joint, "RevoluteJoint")
 
 	BEGIN_CLASS(friction_joint)
 		ADD_METHOD(joint, destroy)
@@ -103,14 +103,14 @@ BEGIN_MODULE(physics)
 		ADD_METHOD(friction_joint, set_max_force)
 		ADD_METHOD(friction_joint, set_max_torque)
 		ADD_GC(free_joint)
-	REGISTER_CLASS(friction_joint, "FrictionJoint")
+	REGISTER_LEAN_CLASS(friction_joint, "FrictionJoint")
 
 	BEGIN_CLASS(gear_joint)
 		ADD_METHOD(joint, destroy)
 		ADD_METHOD(gear_joint, get_ratio)
 		ADD_METHOD(gear_joint, set_ratio)
 		ADD_GC(free_joint)
-	REGISTER_CLASS(gear_joint, "GearJoint")
+	REGISTER_LEAN_CLASS(gear_joint, "GearJoint")
 
 	BEGIN_CLASS(prismatic_joint)
 		ADD_METHOD(joint, destroy)
@@ -120,6 +120,6 @@ BEGIN_MODULE(physics)
 		ADD_METHOD(prismatic_joint, is_motor_enabled)
 		ADD_METHOD(prismatic_joint, is_limit_enabled)
 		ADD_GC(free_joint)
-	REGISTER_CLASS(prismatic_joint, "PrismaticJoint")
+	REGISTER_LEAN_CLASS(prismatic_joint, "PrismaticJoint")
 END_MODULE()
 
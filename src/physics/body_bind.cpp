@@ -16,7 +16,7 @@ END_DISABLE_WARNINGS
 
 log_category("body");
 
-IMPLEMENT_PUSHPOP(Body, body)
+IMPLEMENT_LEAN_PUSHPOP(Body, body, OBJECT_BODY)
 
 Body* pop_body_secure(lua_State* L, int index)
 {
@@ -212,6 +212,7 @@ int mlua_free_body(lua_State* L)
 {
 	log_debug();
 	Body* body = pop_body(L, 1);
+	object_registry_remove(OBJECT_BODY, &body->registry_index);
 	assert_lua_error(L, !body->body, "body hasn't been destroyed");
 	delete body;
 	return 0;
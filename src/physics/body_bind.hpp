@@ -26,6 +26,7 @@ struct Body {
 	Body* nextdestroy;
 	bool getting_destroyed;
 	int ref;
+	size_t registry_index; // see object_registry.h
 };
 
 DECLARE_PUSHPOP(Body, body)
@@ -17,15 +17,15 @@ END_DISABLE_WARNINGS
 
 log_category("joint");
 
-IMPLEMENT_PUSH(RopeJoint, rope_joint)
-IMPLEMENT_PUSH(DistanceJoint, distance_joint)
-IMPLEMENT_PUSH(RevoluteJoint, revolute_joint)
-IMPLEMENT_PUSH(MouseJoint, mouse_joint)
-IMPLEMENT_PUSH(PrismaticJoint, prismatic_joint)
-IMPLEMENT_PUSH(GearJoint, gear_joint)
-IMPLEMENT_PUSH(FrictionJoint, friction_joint)
+IMPLEMENT_LEAN_PUSH(RopeJoint, rope_joint, OBJECT_JOINT)
+IMPLEMENT_LEAN_PUSH(DistanceJoint, distance_joint, OBJECT_JOINT)
+IMPLEMENT_LEAN_PUSH(RevoluteJoint, revolute_joint, OBJECT_JOINT)
+IMPLEMENT_LEAN_PUSH(MouseJoint, mouse_joint, OBJECT_JOINT)
+IMPLEMENT_LEAN_PUSH(PrismaticJoint, prismatic_joint, OBJECT_JOINT)
+IMPLEMENT_LEAN_PUSH(GearJoint, gear_joint, OBJECT_JOINT)
+IMPLEMENT_LEAN_PUSH(FrictionJoint, friction_joint, OBJECT_JOINT)
 
-IMPLEMENT_POP(Joint, joint)
+IMPLEMENT_LEAN_POP(Joint, joint)
 
 Joint* pop_joint_secure(lua_State* L, int index)
 {
@@ -275,6 +275,7 @@ int mlua_free_joint(lua_State* L)
 {
 	log_debug();
 	Joint* joint = pop_joint(L, 1);
+	object_registry_remove(OBJECT_JOINT, &joint->registry_index);
 	assert_lua_error(L, !joint->joint, "joint hasn't been destroyed");
 	delete joint;
 	return 0;
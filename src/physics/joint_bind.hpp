@@ -26,6 +26,7 @@ struct Joint {
 	Joint* nextdestroy;
 	bool getting_destroyed;
 	int ref;
+	size_t registry_index; // see object_registry.h
 };
 
 typedef Joint RevoluteJoint;
@@ -14,10 +14,13 @@ END_DISABLE_WARNINGS
 #include "log.h"
 #include "lua_util.h"
 #include "util.h"
+#ifdef BUILD_UTILS
+#include "utils/array_bind.h"
+#endif
 
 log_category("shape");
 
-IMPLEMENT_PUSHPOP(Shape, shape)
+IMPLEMENT_LEAN_PUSHPOP(Shape, shape, OBJECT_SHAPE)
 
 int mlua_new_shape(lua_State* L)
 {
@@ -51,11 +54,26 @@ int mlua_new_shape(lua_State* L)
 		fixtureDef->shape = circle;
 	} else if (streq(type, "chain")) {
 		b2ChainShape* chain = new b2ChainShape;
-		int number = (lua_gettop(L) - 1) / 2;
-		b2Vec2* vecs = new b2Vec2[number];
-		for (int i = 0; i < number; i++) {
-			vecs[i].x = luaL_checknumber(L, (i + 1) * 2) / pixels_per_meter;
-			vecs[i].y = luaL_checknumber(L, (i + 1) * 2 + 1) / pixels_per_meter;
+		b2Vec2* vecs;
+		int number;
+#ifdef BUILD_UTILS
+		Array* array = test_array(L, 2);
+		if (array) {
+			number = array->length / 2;
+			vecs = new b2Vec2[number];
+			for (int i = 0; i < number; i++) {
+				vecs[i].x = array_get(array, i * 2) / pixels_per_meter;
+				vecs[i].y = array_get(array, i * 2 + 1) / pixels_per_meter;
+			}
+		} else
+#endif
+		{
+			number = (lua_gettop(L) - 1) / 2;
+			vecs = new b2Vec2[number];
+			for (int i = 0; i < number; i++) {
+				vecs[i].x = luaL_checknumber(L, (i + 1) * 2) / pixels_per_meter;
+				vecs[i].y = luaL_checknumber(L, (i + 1) * 2 + 1) / pixels_per_meter;
+			}
 		}
 		chain->CreateLoop(vecs, number);
 		delete[] vecs;
@@ -106,6 +124,7 @@ int mlua_gc_shape(lua_State* L)
 	log_debug();
 
 	Shape* shape = pop_shape(L, 1);
+	object_registry_remove(OBJECT_SHAPE, &shape->registry_index);
 	b2FixtureDef* fixtureDef = shape->fixtureDef;
 	delete fixtureDef->shape;
 	delete fixtureDef;
@@ -24,6 +24,7 @@ struct b2FixtureDef;
 struct Shape {
 	b2FixtureDef* fixtureDef;
 	int ref;
+	size_t registry_index; // see object_registry.h
 };
 
 DECLARE_PUSHPOP(Shape, shape)
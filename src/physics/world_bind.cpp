@@ -32,6 +32,7 @@ END_DISABLE_WARNINGS
 #include "joint_bind.hpp"
 #include "shape_bind.hpp"
 #include "util.h"
+#include "profiler.h"
 
 log_category("world");
 
@@ -168,7 +169,9 @@ int mlua_update_physics(lua_State* L)
 
 	time_accumulator += dt;
 	while (time_accumulator >= timestep) {
+		PROFILER_BEGIN(step);
 		world->Step(timestep, velocityIterations, positionIterations);
+		PROFILER_END(step, "physics_step");
 		time_accumulator -= timestep;
 	}
 
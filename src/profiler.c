@@ -0,0 +1,99 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "profiler.h"
+#include "macro.h"
+#include "util.h"
+
+bool profiler_running = false;
+
+static struct {
+	ProfilerRecord *records;
+	// total number of records since the start, the ring holds the last ones
+	unsigned long count;
+} profiler;
+
+unsigned long profiler_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+void profiler_start(void)
+{
+	if (!profiler.records)
+		profiler.records = new(ProfilerRecord, PROFILER_RECORDS);
+	profiler.count = 0;
+	profiler_running = true;
+}
+
+void profiler_stop(void)
+{
+	profiler_running = false;
+}
+
+void profiler_record(const char *name, unsigned long start, unsigned long end)
+{
+	assert(name);
+	assert(profiler.records);
+
+	ProfilerRecord *record = &profiler.records[profiler.count % PROFILER_RECORDS];
+	record->name = name;
+	record->start = start;
+	record->end = end;
+	profiler.count++;
+}
+
+int profiler_write_trace(const char *filename)
+{
+	FILE *f;
+	unsigned long first = 0;
+
+	assert(filename);
+
+	f = fopen(filename, "w");
+	if (!f)
+		return -errno;
+
+	if (profiler.count > PROFILER_RECORDS)
+		first = profiler.count - PROFILER_RECORDS;
+
+	fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+	for (unsigned long i = first; i < profiler.count; i++) {
+		const ProfilerRecord *record = &profiler.records[i % PROFILER_RECORDS];
+		fprintf(f, "%s\n{\"name\": \"%s\", \"cat\": \"drystal\", \"ph\": \"X\", "
+		        "\"ts\": %lu, \"dur\": %lu, \"pid\": 1, \"tid\": 1}",
+		        i > first ? "," : "", record->name, record->start, record->end - record->start);
+	}
+	fprintf(f, "\n]}\n");
+
+	if (ferror(f)) {
+		fclose(f);
+		return -EIO;
+	}
+	if (fclose(f) != 0)
+		return -errno;
+	return 0;
+}
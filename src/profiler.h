@@ -0,0 +1,60 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+// when full, the oldest records are overwritten
+#define PROFILER_RECORDS 65536
+
+typedef struct ProfilerRecord ProfilerRecord;
+
+struct ProfilerRecord {
+	const char *name; // static string
+	unsigned long start;
+	unsigned long end;
+};
+
+extern bool profiler_running;
+
+// microseconds, same clock as the engine
+unsigned long profiler_now(void);
+void profiler_start(void);
+void profiler_stop(void);
+void profiler_record(const char *name, unsigned long start, unsigned long end);
+// Chrome trace event format, to be opened with chrome://tracing or Perfetto
+int profiler_write_trace(const char *filename);
+
+/*
+ * Scoped zones. When the profiler is stopped, a zone costs a test of
+ * profiler_running. Zones started before profiler_start() are dropped.
+ */
+#define PROFILER_BEGIN(zone) \
+	unsigned long _profiler_ ## zone = profiler_running ? profiler_now() : 0
+#define PROFILER_END(zone, name) \
+	do { \
+		if (profiler_running && _profiler_ ## zone) \
+			profiler_record(name, _profiler_ ## zone, profiler_now()); \
+	} while (0)
+
+#ifdef __cplusplus
+}
+#endif
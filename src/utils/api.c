@@ -16,6 +16,7 @@
  */
 #include "module.h"
 #include "api.h"
+#include "array_bind.h"
 
 extern int json_encode(lua_State* L);
 extern int json_decode(lua_State* L);
@@ -29,5 +30,13 @@ BEGIN_MODULE(utils)
 
 	lua_pushcfunction(L, json_decode);
 	lua_setfield(L, -2, "fromjson");
+
+	DECLARE_FUNCTION(new_array)
+
+	BEGIN_CLASS(array)
+		ADD_METHOD(array, fill)
+		ADD_GC(free_array)
+		PUSH_FUNC("__len", len_array)
+	REGISTER_CLASS_WITH_INDEX_AND_NEWINDEX(array, "Array")
 END_MODULE()
 
@@ -0,0 +1,119 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "util.h"
+
+const char *ARRAY_TYPE_NAMES[ARRAY_TYPE_COUNT] = {
+	"float32",
+	"int16",
+	"uint8",
+};
+
+int array_type_from_name(const char *name, ArrayType *type)
+{
+	assert(name);
+	assert(type);
+
+	for (int i = 0; i < ARRAY_TYPE_COUNT; i++) {
+		if (streq(name, ARRAY_TYPE_NAMES[i])) {
+			*type = i;
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+size_t array_element_size(ArrayType type)
+{
+	switch (type) {
+		case ARRAY_FLOAT32:
+			return sizeof(float);
+		case ARRAY_INT16:
+			return sizeof(int16_t);
+		case ARRAY_UINT8:
+			return sizeof(uint8_t);
+		default:
+			assert(false);
+			return 0;
+	}
+}
+
+Array *array_new(ArrayType type, unsigned int length)
+{
+	Array *a = new0(Array, 1);
+	a->type = type;
+	a->length = length;
+	a->data = xcalloc(length ? length : 1, array_element_size(type));
+
+	return a;
+}
+
+void array_free(Array *a)
+{
+	if (!a)
+		return;
+
+	free(a->data);
+	free(a);
+}
+
+void array_set(Array *a, unsigned int i, double value)
+{
+	assert(a);
+	assert(i < a->length);
+
+	switch (a->type) {
+		case ARRAY_FLOAT32:
+			((float *) a->data)[i] = value;
+			break;
+		case ARRAY_INT16:
+			if (value < INT16_MIN)
+				value = INT16_MIN;
+			else if (value > INT16_MAX)
+				value = INT16_MAX;
+			((int16_t *) a->data)[i] = value;
+			break;
+		case ARRAY_UINT8:
+			if (value < 0)
+				value = 0;
+			else if (value > UINT8_MAX)
+				value = UINT8_MAX;
+			((uint8_t *) a->data)[i] = value;
+			break;
+		default:
+			assert(false);
+	}
+}
+
+void array_get_floats(const Array *a, unsigned int first, unsigned int count, float *floats)
+{
+	assert(a);
+	assert(floats);
+	assert(first + count <= a->length);
+
+	if (a->type == ARRAY_FLOAT32) {
+		memcpy(floats, (const float *) a->data + first, count * sizeof(float));
+		return;
+	}
+	for (unsigned int i = 0; i < count; i++)
+		floats[i] = array_get(a, first + i);
+}
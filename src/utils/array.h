@@ -0,0 +1,79 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum ArrayType {
+	ARRAY_FLOAT32,
+	ARRAY_INT16,
+	ARRAY_UINT8,
+	ARRAY_TYPE_COUNT,
+};
+typedef enum ArrayType ArrayType;
+
+typedef struct Array Array;
+
+struct Array {
+	ArrayType type;
+	unsigned int length;
+	void *data;
+	int ref;
+	size_t registry_index; // see object_registry.h
+};
+
+extern const char *ARRAY_TYPE_NAMES[ARRAY_TYPE_COUNT];
+
+// returns -EINVAL if name is not a type
+int array_type_from_name(const char *name, ArrayType *type);
+size_t array_element_size(ArrayType type);
+
+// the elements are zeroed
+Array *array_new(ArrayType type, unsigned int length);
+void array_free(Array *a);
+
+/*
+ * Integer arrays store the values truncated and clamped to their range,
+ * so 300 becomes 255 in an uint8 array.
+ */
+static inline double array_get(const Array *a, unsigned int i)
+{
+	switch (a->type) {
+		case ARRAY_FLOAT32:
+			return ((const float *) a->data)[i];
+		case ARRAY_INT16:
+			return ((const int16_t *) a->data)[i];
+		case ARRAY_UINT8:
+			return ((const uint8_t *) a->data)[i];
+		default:
+			return 0;
+	}
+}
+
+void array_set(Array *a, unsigned int i, double value);
+
+// copies count elements starting at first into floats, converting them if needed
+void array_get_floats(const Array *a, unsigned int first, unsigned int count, float *floats);
+
+#ifdef __cplusplus
+}
+#endif
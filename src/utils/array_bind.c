@@ -0,0 +1,138 @@
+/**
+ * This file is part of Drystal.
+ *
+ * Drystal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Drystal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Drystal.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <assert.h>
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "array_bind.h"
+#include "util.h"
+
+IMPLEMENT_LEAN_PUSHPOP(Array, array, OBJECT_ARRAY)
+
+Array *test_array(lua_State *L, int index)
+{
+	assert(L);
+
+	Array **p = (Array **) luaL_testudata(L, index, "array");
+	return p ? *p : NULL;
+}
+
+int mlua_new_array(lua_State *L)
+{
+	assert(L);
+
+	ArrayType type;
+	const char *name = luaL_checkstring(L, 1);
+	if (array_type_from_name(name, &type) < 0)
+		return luaL_error(L, "new_array: unknown type '%s', must be float32, int16 or uint8", name);
+
+	lua_Integer length;
+	bool from_table = lua_istable(L, 2);
+	if (from_table)
+		length = luaL_len(L, 2);
+	else
+		length = luaL_checkinteger(L, 2);
+	assert_lua_error(L, length >= 0, "new_array: length must be >= 0");
+
+	Array *array = array_new(type, length);
+	if (from_table) {
+		for (lua_Integer i = 0; i < length; i++) {
+			int isnum;
+			lua_rawgeti(L, 2, i + 1);
+			lua_Number value = lua_tonumberx(L, -1, &isnum);
+			lua_pop(L, 1);
+			if (!isnum) {
+				array_free(array);
+				return luaL_error(L, "new_array: the table must only contain numbers");
+			}
+			array_set(array, i, value);
+		}
+	}
+	push_array(L, array);
+	return 1;
+}
+
+int mlua_array_class_index(lua_State *L)
+{
+	assert(L);
+
+	Array *array = pop_array(L, 1);
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		lua_Integer i = luaL_checkinteger(L, 2);
+		if (i >= 1 && i <= (lua_Integer) array->length)
+			lua_pushnumber(L, array_get(array, i - 1));
+		else
+			lua_pushnil(L);
+		return 1;
+	}
+
+	const char *index = luaL_checkstring(L, 2);
+	if (streq(index, "length")) {
+		lua_pushinteger(L, array->length);
+	} else if (streq(index, "type")) {
+		lua_pushstring(L, ARRAY_TYPE_NAMES[array->type]);
+	} else {
+		return mlua_lean_class_index(L);
+	}
+	return 1;
+}
+
+int mlua_array_class_newindex(lua_State *L)
+{
+	assert(L);
+
+	Array *array = pop_array(L, 1);
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		lua_Integer i = luaL_checkinteger(L, 2);
+		lua_Number value = luaL_checknumber(L, 3);
+		assert_lua_error(L, i >= 1 && i <= (lua_Integer) array->length, "array: index out of bounds");
+		array_set(array, i - 1, value);
+	} else {
+		return mlua_lean_class_newindex(L);
+	}
+	return 0;
+}
+
+int mlua_len_array(lua_State *L)
+{
+	assert(L);
+
+	Array *array = pop_array(L, 1);
+	lua_pushinteger(L, array->length);
+	return 1;
+}
+
+int mlua_fill_array(lua_State *L)
+{
+	assert(L);
+
+	Array *array = pop_array(L, 1);
+	lua_Number value = luaL_checknumber(L, 2);
+	for (unsigned int i = 0; i < array->length; i++)
+		array_set(array, i, value);
+	return 0;
+}
+
+int mlua_free_array(lua_State *L)
+{
+	assert(L);
+
+	Array *array = pop_array(L, 1);
+	object_registry_remove(OBJECT_ARRAY, &array->registry_index);
+	array_free(array);
+	return 0;
+}
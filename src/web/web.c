@@ -34,7 +34,7 @@ static void onsuccess(const char* filename)
 {
 	assert(filename);
 
-	if (dlua_get_function("on_wget_success")) {
+	if (dlua_get_callback(CALLBACK_ON_WGET_SUCCESS)) {
 		lua_State* L = dlua_get_lua_state();
 		lua_pushstring(L, filename);
 		call_lua_function(L, 1, 0);
@@ -45,7 +45,7 @@ static void onerror(const char* filename)
 {
 	assert(filename);
 
-	if (dlua_get_function("on_wget_error")) {
+	if (dlua_get_callback(CALLBACK_ON_WGET_ERROR)) {
 		lua_State* L = dlua_get_lua_state();
 		lua_pushstring(L, filename);
 		call_lua_function(L, 1, 0);
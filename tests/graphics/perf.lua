@@ -8,10 +8,13 @@ local draw_triangle = {name='draw_triangle'}
 local draw_sprite_simple = {name='draw_sprite_simple'}
 local draw_sprite_rotated = {name='draw_sprite_rotated'}
 local draw_sprite_resized = {name='draw_sprite_resized'}
+local draw_triangles = {name='draw_triangles'}
+local draw_quads = {name='draw_quads'}
 local draw_font_nocolor = {name='draw_font_nocolor'}
 local draw_font_color = {name='draw_font_color'}
 local state = {}
-local states = { draw_triangle, draw_sprite_simple, draw_sprite_rotated, draw_sprite_resized, draw_font_nocolor, draw_font_color }
+local states = { draw_triangle, draw_sprite_simple, draw_sprite_rotated, draw_sprite_resized,
+                 draw_triangles, draw_quads, draw_font_nocolor, draw_font_color }
 local current_state = 1
 local number = 0
 local tick = 0
@@ -85,6 +88,53 @@ function draw_sprite_resized:draw()
 	end
 end
 
+function draw_triangles:init()
+	self.array = {}
+end
+
+function draw_triangles:draw()
+	drystal.set_color(0, 0, 0)
+	drystal.draw_background()
+
+	drystal.set_alpha(255)
+	drystal.set_color(255, 0, 0)
+	local array = self.array
+	local n = 0
+	for i = 1, number do
+		local x = random(W)
+		local y = random(H)
+		array[n+1], array[n+2] = x, y
+		array[n+3], array[n+4] = x+random(20), y+random(20)
+		array[n+5], array[n+6] = x+random(20), y+random(20)
+		n = n + 6
+	end
+	drystal.draw_triangles(array, number)
+end
+
+function draw_quads:init()
+	self.array = {}
+end
+
+function draw_quads:draw()
+	drystal.set_color(255, 255, 255)
+	drystal.set_alpha(255)
+	drystal.draw_background()
+
+	local array = self.array
+	local sx, sy, sw, sh = sprite.x, sprite.y, sprite.w, sprite.h
+	local n = 0
+	for i = 1, number do
+		local x = random(W)
+		local y = random(H)
+		array[n+1], array[n+2], array[n+3], array[n+4] = sx, sy, sx+sw, sy
+		array[n+5], array[n+6], array[n+7], array[n+8] = sx+sw, sy+sh, sx, sy+sh
+		array[n+9], array[n+10], array[n+11], array[n+12] = x, y, x+sw, y
+		array[n+13], array[n+14], array[n+15], array[n+16] = x+sw, y+sh, x, y+sh
+		n = n + 16
+	end
+	drystal.draw_quads(array, number)
+end
+
 function highlight(text, pos)
 	return text:sub(0, pos-1) .. '{big|'.. text:sub(pos, pos) .. '}' .. text:sub(pos+1, #text)
 end
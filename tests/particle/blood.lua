@@ -21,6 +21,7 @@ sys_blood:set_initial_velocity(50, 150)
 sys_blood:set_initial_acceleration(-100, 0)
 sys_blood:set_offset(0, 0, 0, 0)
 sys_blood:set_texture(tex, 128, 0)
+sys_blood:set_max_size(2000, true)
 
 function drystal.init()
 	drystal.resize(800, 600)
@@ -42,7 +43,7 @@ end
 local last_splash = 0
 function drystal.mouse_press(x, y, b)
 	if time - last_splash > 0.03 then
-		sys_blood:emit(60)
+		sys_blood:burst(60)
 		squish:play()
 	end
 	last_splash = time
@@ -28,9 +28,7 @@ function drystal.update(dt)
 		dt = .06
 	end
 	sys1:update(dt)
-	for _, s in ipairs(systems) do
-		s:update(dt)
-	end
+	drystal.update_particle_systems(systems, dt)
 end
 
 function drystal.draw()